@@ -0,0 +1,47 @@
+#ifndef ASYNC_CONTROLLER_H_INCLUDED
+#define ASYNC_CONTROLLER_H_INCLUDED
+
+#include "PlayerController.h"
+#include <string>
+#include <vector>
+
+/* Interface to a player controller that calculates its moves asynchronously
+   (e.g. on a worker thread, or in a separate process), so the client is never
+   blocked by a slow bot.
+
+   At most one move request is outstanding at any time. If the client stops
+   waiting for a result, the result is still delivered by the next call to
+   wait_move(), so a slow bot keeps playing, only with a bit more lag.
+*/
+class AsyncController
+{
+public:
+    virtual ~AsyncController() { };
+
+    /* Forwarded to the controller in the order in which they are called: */
+    virtual void restart(const GameParameters &gp) = 0;
+    virtual void watch_player( int player_index, int timestamp, Move move,
+        double move_rate, double turn_rate, bool solid,
+        const Position &old_pos, const Position &new_pos ) = 0;
+    virtual void listen(const std::string &name, const std::string &text) = 0;
+
+    /* Called for each line segment drawn on the client's field, so the
+       controller's view of the field can be kept up to date. */
+    virtual void drawLine(const Position &p, const Position &q, int n) = 0;
+
+    /* Requests a move for the given timestamp, unless a previous request is
+       still outstanding or its result has not been retrieved yet.
+       Returns whether a new request was made. */
+    virtual bool request_move( int timestamp, const std::vector<Player> &players,
+                               int player_index ) = 0;
+
+    /* Waits for up to `timeout' seconds for a requested move to be available.
+       If so, returns true and stores the move and the time the controller
+       spent calculating it in `move' and `latency'. */
+    virtual bool wait_move(double timeout, Move *move, double *latency) = 0;
+
+    /* Retrieves chat messages queued by the controller. */
+    virtual bool retrieve_message(std::string *text) = 0;
+};
+
+#endif /* ndef ASYNC_CONTROLLER_H_INCLUDED */
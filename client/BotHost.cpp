@@ -0,0 +1,158 @@
+/* Bot host process.
+
+   Runs a single bot outside the client, so that a bot that crashes or hangs
+   cannot take the client down with it. The client (see BotProcess.cpp) starts
+   this program as:
+
+        zatacka-bothost <bot name> <field fd> <shm fd> <request fd> <response fd>
+
+   The game field is mapped read-only from its shared memory object (which
+   the host can only access through a read-only descriptor), so the bot
+   always sees the client's field without any copying. Only bots that may
+   run on a worker thread (i.e. that do not use FLTK) and are not batched are
+   accepted. */
+
+#include "BotShm.h"
+#include "PlayerController.h"
+#include <common/Debug.h>
+#include <common/Time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+
+static BotShared *g_shared;     /* shared memory (read/write) */
+static const Field *g_field;    /* game field (read-only) */
+static int g_fd_requests;       /* request notifications (read end) */
+static int g_fd_responses;      /* response notifications (write end) */
+static std::vector<FieldChange> g_changes;  /* lines drawn since last move */
+
+static void respond(const BotMessage &msg)
+{
+    /* The client consumes responses every frame, so the ring should not
+       stay full for long. */
+    while (!bot_ring_push(&g_shared->responses, msg)) usleep(1000);
+    bot_notify(g_fd_responses);
+}
+
+static void process(PlayerController *pc, BotMessage &msg)
+{
+    switch (msg.type)
+    {
+    case BOT_RESTART:
+        g_changes.clear();
+        pc->restart(msg.gp);
+        break;
+
+    case BOT_LINE:
+        {
+            FieldChange fc = { msg.n, msg.p, msg.q, msg.rect };
+            g_changes.push_back(fc);
+        } break;
+
+    case BOT_WATCH:
+        pc->watch_player( msg.n, msg.timestamp, (Move)msg.move, msg.move_rate,
+                          msg.turn_rate, msg.solid, msg.p, msg.q );
+        break;
+
+    case BOT_LISTEN:
+        {
+            std::string name = msg.name, text = msg.text;
+            pc->listen(name, text);
+        } break;
+
+    case BOT_MOVE:
+        {
+            int num_players = g_shared->num_players;
+            std::vector<Player> players( g_shared->players,
+                                         g_shared->players + num_players );
+            for (int n = 0; n < num_players; ++n)
+            {
+                players[n].name = g_shared->names[n];
+            }
+
+            double t = time_now();
+            pc->field_changed(g_changes);
+            g_changes.clear();
+            Move m = pc->move(msg.timestamp, &players[0], msg.n, *g_field);
+
+            BotMessage res;
+            memset(&res, 0, sizeof(res));
+            res.type       = BOT_RESULT;
+            res.move       = m;
+            res.latency    = time_now() - t;
+            res.generation = msg.generation;
+            respond(res);
+        } break;
+    }
+
+    /* Pass on chat messages queued by the bot */
+    std::string text;
+    while (pc->retrieve_message(&text))
+    {
+        BotMessage say;
+        memset(&say, 0, sizeof(say));
+        say.type = BOT_SAY;
+        strncpy(say.text, text.c_str(), BOT_TEXT_MAX - 1);
+        respond(say);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 6)
+    {
+        fprintf( stderr, "usage: %s <bot> <field fd> <shm fd> <request fd> "
+                         "<response fd>\n", argv[0] );
+        return 1;
+    }
+    int fd_field   = atoi(argv[2]);
+    int fd_shm     = atoi(argv[3]);
+    g_fd_requests  = atoi(argv[4]);
+    g_fd_responses = atoi(argv[5]);
+
+    /* Mask SIGPIPE, so we exit normally when the client goes away */
+    struct sigaction sa;
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    void *field = mmap( NULL, sizeof(Field), PROT_READ, MAP_SHARED,
+                        fd_field, 0 );
+    void *shared = mmap( NULL, sizeof(BotShared), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd_shm, 0 );
+    if (field == MAP_FAILED || shared == MAP_FAILED)
+    {
+        fatal("could not map shared memory");
+    }
+    close(fd_field);
+    close(fd_shm);
+    g_field  = (const Field*)field;
+    g_shared = (BotShared*)shared;
+
+    BotMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    PlayerController *pc = PlayerController::load_bot(argv[1]);
+    if (pc == NULL || !pc->threaded() || pc->batched())
+    {
+        if (pc != NULL) info("%s cannot run in a bot host", argv[1]);
+        msg.type = BOT_BYE;
+        respond(msg);
+        return 1;
+    }
+    msg.type = BOT_HELLO;
+    respond(msg);
+
+    for (;;)
+    {
+        while (bot_ring_pop(&g_shared->requests, &msg)) process(pc, msg);
+        if (bot_wait(g_fd_requests, -1) < 0) break;
+    }
+
+    return 0;
+}
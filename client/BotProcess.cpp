@@ -0,0 +1,457 @@
+#ifndef WIN32
+
+#include "BotProcess.h"
+#include "common.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define BOT_HOST_PATH       "./zatacka-bothost"
+#define BOT_HOST_NICE       10      /* scheduling priority of bot hosts */
+#define BOT_HOST_TIMEOUT    2.0     /* max. seconds per move before restart */
+#define BOT_HOST_RESTARTS   5       /* max. number of restarts per bot */
+#define BOT_HELLO_TIMEOUT   5.0     /* max. seconds for the bot to load */
+
+BotProcess *BotProcess::start(const char *name)
+{
+    /* Only start a host if it has a chance of loading the bot */
+    char path[64];
+    if (strchr(name, '/') || strchr(name, '.') || strlen(name) > 40)
+    {
+        return NULL;
+    }
+    sprintf(path, "bots/%s.so", name);
+    if (access(path, R_OK) != 0 || access(BOT_HOST_PATH, X_OK) != 0)
+    {
+        return NULL;
+    }
+
+    BotProcess *bp = new BotProcess(name);
+    if (!bp->map_shared() || !bp->spawn() || !bp->wait_hello())
+    {
+        delete bp;
+        return NULL;
+    }
+    info("Bot %s running in host process %d.", name, (int)bp->m_pid);
+    return bp;
+}
+
+BotProcess::BotProcess(const char *name)
+    : m_name(name), m_fd_field(-1), m_fd_shm(-1), m_field(NULL),
+      m_shared(NULL), m_pid(-1),
+      m_fd_requests(-1), m_fd_responses(-1), m_restarts(0), m_clear(false),
+      m_have_gp(false), m_pending(false), m_has_result(false),
+      m_result(MOVE_FORWARD), m_latency(0), m_request_time(0),
+      m_generation(0)
+{
+    memset(&m_gp, 0, sizeof(m_gp));
+}
+
+BotProcess::~BotProcess()
+{
+    stop_host();
+    if (m_field != NULL) munmap(m_field, sizeof(Field));
+    if (m_shared != NULL) munmap(m_shared, sizeof(BotShared));
+    if (m_fd_field >= 0) close(m_fd_field);
+    if (m_fd_shm >= 0) close(m_fd_shm);
+}
+
+/* Creates an anonymous shared memory object of the given size, and maps it
+   read/write. Returns a descriptor for the object that is opened read-only
+   if `read_only' is set, or read/write otherwise, or -1 on failure. */
+static int shm_create(size_t size, bool read_only, void **mem)
+{
+    static int counter = 0;
+    char name[64];
+    sprintf(name, "/zatacka-bot-%d-%d", (int)getpid(), counter++);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        warn("could not create shared memory object %s", name);
+        return -1;
+    }
+    int fd_ro = read_only ? shm_open(name, O_RDONLY, 0) : -1;
+    shm_unlink(name);
+
+    *mem = MAP_FAILED;
+    if (ftruncate(fd, size) != 0)
+    {
+        warn("could not resize shared memory object");
+    }
+    else
+    {
+        *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (*mem == MAP_FAILED) warn("could not map shared memory");
+    }
+    if (read_only)
+    {
+        close(fd);
+        fd = fd_ro;
+    }
+    if (*mem == MAP_FAILED || fd < 0)
+    {
+        if (*mem != MAP_FAILED) munmap(*mem, size);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+bool BotProcess::map_shared()
+{
+    void *field, *shared;
+    m_fd_field = shm_create(sizeof(Field), true, &field);
+    if (m_fd_field < 0) return false;
+    m_field = (Field*)field;
+    m_fd_shm = shm_create(sizeof(BotShared), false, &shared);
+    if (m_fd_shm < 0) return false;
+    m_shared = (BotShared*)shared;
+    return true;
+}
+
+bool BotProcess::spawn()
+{
+    int fds_req[2], fds_resp[2];
+    if (pipe(fds_req) != 0) return false;
+    if (pipe(fds_resp) != 0)
+    {
+        close(fds_req[0]);
+        close(fds_req[1]);
+        return false;
+    }
+
+    /* Start with empty rings (the previous host, if any, is gone) */
+    m_shared->requests.head  = m_shared->requests.tail  = 0;
+    m_shared->responses.head = m_shared->responses.tail = 0;
+    m_backlog.clear();
+
+    /* Format arguments before forking; the child may only call functions
+       that are safe to call between fork() and exec(). */
+    char arg_field[16], arg_shm[16], arg_req[16], arg_resp[16];
+    sprintf(arg_field, "%d", m_fd_field);
+    sprintf(arg_shm,  "%d", m_fd_shm);
+    sprintf(arg_req,  "%d", fds_req[0]);
+    sprintf(arg_resp, "%d", fds_resp[1]);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        fcntl(m_fd_field, F_SETFD, 0);
+        fcntl(m_fd_shm, F_SETFD, 0);
+        close(fds_req[1]);
+        close(fds_resp[0]);
+        setpriority(PRIO_PROCESS, 0, BOT_HOST_NICE);
+        struct rlimit rlim = { 0, 0 };
+        setrlimit(RLIMIT_CORE, &rlim);
+        execl( BOT_HOST_PATH, BOT_HOST_PATH, m_name.c_str(),
+               arg_field, arg_shm, arg_req, arg_resp, (char*)NULL );
+        _exit(127);
+    }
+    close(fds_req[0]);
+    close(fds_resp[1]);
+    if (pid < 0)
+    {
+        warn("could not start bot host for %s", m_name.c_str());
+        close(fds_req[1]);
+        close(fds_resp[0]);
+        return false;
+    }
+
+    m_pid          = pid;
+    m_fd_requests  = fds_req[1];
+    m_fd_responses = fds_resp[0];
+    fcntl(m_fd_requests,  F_SETFD, FD_CLOEXEC);
+    fcntl(m_fd_responses, F_SETFD, FD_CLOEXEC);
+    fcntl(m_fd_requests,  F_SETFL, O_NONBLOCK);
+    fcntl(m_fd_responses, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+bool BotProcess::wait_hello()
+{
+    double deadline = time_now() + BOT_HELLO_TIMEOUT;
+    for (;;)
+    {
+        BotMessage msg;
+        while (bot_ring_pop(&m_shared->responses, &msg))
+        {
+            if (msg.type == BOT_HELLO) return true;
+            if (msg.type == BOT_BYE) return false;
+        }
+        double left = deadline - time_now();
+        if (left <= 0 || bot_wait(m_fd_responses, (int)(1e3*left) + 1) < 0)
+        {
+            return false;
+        }
+    }
+}
+
+void BotProcess::stop_host()
+{
+    if (m_pid > 0)
+    {
+        kill(m_pid, SIGKILL);
+        waitpid(m_pid, NULL, 0);
+        m_pid = -1;
+    }
+    if (m_fd_requests >= 0) close(m_fd_requests);
+    if (m_fd_responses >= 0) close(m_fd_responses);
+    m_fd_requests = m_fd_responses = -1;
+}
+
+void BotProcess::check_host()
+{
+    if (m_pid <= 0) return;
+
+    if (waitpid(m_pid, NULL, WNOHANG) == m_pid)
+    {
+        warn("bot host for %s exited unexpectedly", m_name.c_str());
+        m_pid = -1;
+    }
+    else
+    if (m_pending && time_now() - m_request_time > BOT_HOST_TIMEOUT)
+    {
+        warn("bot %s is not responding", m_name.c_str());
+    }
+    else
+    {
+        return;
+    }
+
+    stop_host();
+    m_pending = m_has_result = false;
+    if (++m_restarts > BOT_HOST_RESTARTS)
+    {
+        warn("bot %s crashed too often; not restarting", m_name.c_str());
+        return;
+    }
+    info("Restarting bot host for %s.", m_name.c_str());
+    if (!spawn()) return;
+
+    /* The field in shared memory is still valid, but the bot must be told
+       that a game is in progress, and that the whole field has changed (so
+       bots that keep data derived from the field re-read it). */
+    if (m_have_gp)
+    {
+        BotMessage msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = BOT_RESTART;
+        msg.gp   = m_gp;
+        post(msg);
+
+        sync_field();
+        memset(&msg, 0, sizeof(msg));
+        msg.type = BOT_LINE;
+        msg.n    = -1;
+        msg.rect.x1 = msg.rect.y1 = 0;
+        msg.rect.x2 = msg.rect.y2 = FIELD_SIZE;
+        post(msg);
+    }
+}
+
+void BotProcess::post(const BotMessage &msg)
+{
+    if (m_pid <= 0) return;
+    if (!m_backlog.empty() || !bot_ring_push(&m_shared->requests, msg))
+    {
+        m_backlog.push_back(msg);
+        return;
+    }
+    bot_notify(m_fd_requests);
+}
+
+void BotProcess::flush()
+{
+    if (m_backlog.empty() || m_pid <= 0) return;
+    while ( !m_backlog.empty() &&
+            bot_ring_push(&m_shared->requests, m_backlog.front()) )
+    {
+        m_backlog.pop_front();
+    }
+    bot_notify(m_fd_requests);
+}
+
+void BotProcess::receive()
+{
+    if (m_pid <= 0) return;
+
+    BotMessage msg;
+    while (bot_ring_pop(&m_shared->responses, &msg))
+    {
+        if (msg.type == BOT_RESULT && msg.generation == m_generation)
+        {
+            /* The host is not trusted; keep the last move if it returns
+               anything other than a valid move. */
+            if ( msg.move == MOVE_FORWARD || msg.move == MOVE_TURN_LEFT ||
+                 msg.move == MOVE_TURN_RIGHT )
+            {
+                m_result = (Move)msg.move;
+            }
+            else
+            {
+                warn( "bot %s returned invalid move %d",
+                      m_name.c_str(), msg.move );
+            }
+            m_latency    = msg.latency;
+            m_has_result = true;
+            m_pending    = false;
+        }
+        if (msg.type == BOT_SAY)
+        {
+            msg.text[BOT_TEXT_MAX - 1] = '\0';
+            m_messages.push_back(msg.text);
+        }
+    }
+}
+
+void BotProcess::sync_field()
+{
+    if (m_clear)
+    {
+        memset(m_field, 0, sizeof(Field));
+        m_clear = false;
+    }
+    for (size_t i = 0; i < m_lines.size(); ++i)
+    {
+        const Segment &s = m_lines[i];
+        BotMessage msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = BOT_LINE;
+        msg.n    = s.n;
+        msg.p    = s.p;
+        msg.q    = s.q;
+        field_line_th( m_field, &s.p, &s.q, FIELD_SIZE*m_gp.line_width,
+                       s.n + 1, &msg.rect );
+        post(msg);
+    }
+    m_lines.clear();
+}
+
+void BotProcess::restart(const GameParameters &gp)
+{
+    /* Requests and results from the previous game are no longer needed */
+    m_backlog.clear();
+    m_lines.clear();
+    m_clear      = true;
+    m_pending    = false;
+    m_has_result = false;
+    ++m_generation;
+
+    m_gp      = gp;
+    m_have_gp = true;
+    sync_field();
+
+    BotMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = BOT_RESTART;
+    msg.gp   = gp;
+    post(msg);
+}
+
+void BotProcess::drawLine(const Position &p, const Position &q, int n)
+{
+    Segment s = { p, q, n };
+    m_lines.push_back(s);
+    if (!m_pending) sync_field();
+}
+
+void BotProcess::watch_player( int player_index, int timestamp, Move move,
+    double move_rate, double turn_rate, bool solid,
+    const Position &old_pos, const Position &new_pos )
+{
+    BotMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type      = BOT_WATCH;
+    msg.n         = player_index;
+    msg.timestamp = timestamp;
+    msg.move      = move;
+    msg.move_rate = move_rate;
+    msg.turn_rate = turn_rate;
+    msg.solid     = solid;
+    msg.p         = old_pos;
+    msg.q         = new_pos;
+    post(msg);
+}
+
+void BotProcess::listen(const std::string &name, const std::string &text)
+{
+    BotMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = BOT_LISTEN;
+    strncpy(msg.name, name.c_str(), BOT_NAME_MAX - 1);
+    strncpy(msg.text, text.c_str(), BOT_TEXT_MAX - 1);
+    post(msg);
+}
+
+bool BotProcess::request_move( int timestamp, const std::vector<Player> &players,
+                               int player_index )
+{
+    check_host();
+    receive();
+    flush();
+    if (m_pid <= 0 || m_pending || m_has_result) return false;
+
+    /* The host does not touch the field or player list until it processes
+       the request below, and we do not touch them until it responds. */
+    sync_field();
+    int num_players = (int)players.size();
+    if (num_players > BOT_MAX_PLAYERS) num_players = BOT_MAX_PLAYERS;
+    for (int n = 0; n < num_players; ++n)
+    {
+        m_shared->players[n] = players[n];
+        m_shared->players[n].name = NULL;
+        strncpy( m_shared->names[n], players[n].name ? players[n].name : "",
+                 BOT_NAME_MAX - 1 );
+        m_shared->names[n][BOT_NAME_MAX - 1] = '\0';
+    }
+    m_shared->num_players = num_players;
+
+    BotMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type       = BOT_MOVE;
+    msg.timestamp  = timestamp;
+    msg.n          = player_index;
+    msg.generation = m_generation;
+    m_pending      = true;
+    m_request_time = time_now();
+    post(msg);
+    return true;
+}
+
+bool BotProcess::wait_move(double timeout, Move *move, double *latency)
+{
+    check_host();
+    flush();
+    receive();
+
+    double deadline = time_now() + timeout;
+    while (!m_has_result && m_pending && m_pid > 0)
+    {
+        double left = deadline - time_now();
+        if (left <= 0) break;
+        if (bot_wait(m_fd_responses, (int)(1e3*left)) < 0) break;
+        receive();
+    }
+
+    if (!m_has_result) return false;
+    *move    = m_result;
+    *latency = m_latency;
+    m_has_result = false;
+    return true;
+}
+
+bool BotProcess::retrieve_message(std::string *text)
+{
+    receive();
+    if (m_messages.empty()) return false;
+    if (text != NULL) *text = m_messages.front();
+    m_messages.pop_front();
+    return true;
+}
+
+#endif /* ndef WIN32 */
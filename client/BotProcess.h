@@ -0,0 +1,100 @@
+#ifndef BOT_PROCESS_H_INCLUDED
+#define BOT_PROCESS_H_INCLUDED
+
+#ifndef WIN32
+
+#include "AsyncController.h"
+#include "BotShm.h"
+#include <deque>
+#include <sys/types.h>
+
+/* Runs a bot in a separate bot host process (zatacka-bothost).
+
+   The game field lives in shared memory, which the host maps read-only.
+   Line segments are drawn into it directly, except while a move request is
+   outstanding: then they are held back until the next request, so the bot
+   sees the field exactly as it was when its move was requested.
+
+   If the host crashes, or does not respond to a move request in time, it is
+   killed and restarted (up to a limited number of times). The host runs with
+   a lowered scheduling priority, so a spinning bot cannot starve the client.
+   The application must ignore SIGPIPE, or writing to a crashed host kills it.
+*/
+class BotProcess : public AsyncController
+{
+public:
+    /* Starts a bot host for the named bot. Returns NULL if no host could be
+       started, or if the bot cannot run in a host process. */
+    static BotProcess *start(const char *name);
+    ~BotProcess();
+
+    void restart(const GameParameters &gp);
+    void watch_player( int player_index, int timestamp, Move move,
+        double move_rate, double turn_rate, bool solid,
+        const Position &old_pos, const Position &new_pos );
+    void listen(const std::string &name, const std::string &text);
+    void drawLine(const Position &p, const Position &q, int n);
+    bool request_move( int timestamp, const std::vector<Player> &players,
+                       int player_index );
+    bool wait_move(double timeout, Move *move, double *latency);
+    bool retrieve_message(std::string *text);
+
+private:
+    struct Segment
+    {
+        Position p, q;
+        int n;
+    };
+
+    explicit BotProcess(const char *name);
+    bool map_shared();
+    bool spawn();
+    bool wait_hello();
+    void stop_host();
+    void check_host();
+    void post(const BotMessage &msg);
+    void flush();
+    void receive();
+    void sync_field();
+
+    BotProcess(const BotProcess &);
+    BotProcess &operator=(const BotProcess &);
+
+private:
+    std::string m_name;
+    int m_fd_field;                 /* shared game field (read-only) */
+    int m_fd_shm;                   /* shared rings and player list */
+    Field *m_field;                 /* shared game field */
+    BotShared *m_shared;            /* shared rings and player list */
+    pid_t m_pid;                    /* bot host process (or -1) */
+    int m_fd_requests;              /* request notifications (write end) */
+    int m_fd_responses;             /* response notifications (read end) */
+    int m_restarts;                 /* number of times the host restarted */
+
+    std::deque<BotMessage> m_backlog;   /* requests that did not fit */
+    std::vector<Segment> m_lines;       /* segments not yet drawn */
+    bool m_clear;                       /* field must be cleared first */
+
+    bool m_have_gp;                 /* game parameters known? */
+    GameParameters m_gp;            /* current game parameters */
+    bool m_pending;                 /* move request outstanding? */
+    bool m_has_result;              /* move calculated but not retrieved? */
+    Move m_result;                  /* last move calculated */
+    double m_latency;               /* time taken to calculate m_result */
+    double m_request_time;          /* time of last move request */
+    int m_generation;               /* incremented on restart */
+    std::deque<std::string> m_messages;
+};
+
+/* Placeholder for a bot that runs in a bot host process; its moves are
+   obtained through the corresponding BotProcess instead. */
+class SandboxedController : public PlayerController
+{
+public:
+    void restart(const GameParameters &gp) { (void)gp; }
+    Move move(int, const Player *, int, const Field &) { return MOVE_FORWARD; }
+};
+
+#endif /* ndef WIN32 */
+
+#endif /* ndef BOT_PROCESS_H_INCLUDED */
@@ -0,0 +1,128 @@
+#ifndef BOT_SHM_H_INCLUDED
+#define BOT_SHM_H_INCLUDED
+
+/* Shared memory layout used between the client and a bot host process.
+
+   The game field and a BotShared structure are kept in two separate shared
+   memory objects. Only the client writes the field: the host is given a
+   read-only descriptor for it, so it cannot map the field writable.
+   Requests (client to host) and responses (host to client) are passed
+   through single-producer/single-consumer rings; a pipe per direction is
+   used only to wake up the other side when it is idle.
+*/
+
+#include "GameModel.h"
+#include <common/Field.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define BOT_RING_SIZE   1024    /* messages per ring (power of two!) */
+#define BOT_MAX_PLAYERS  256    /* player list size in shared memory */
+#define BOT_NAME_MAX      32    /* maximum name length (including NUL) */
+#define BOT_TEXT_MAX     256    /* maximum chat message length (incl. NUL) */
+
+enum BotMessageType
+{
+    /* Requests */
+    BOT_RESTART, BOT_WATCH, BOT_LISTEN, BOT_LINE, BOT_MOVE,
+
+    /* Responses */
+    BOT_HELLO,      /* bot loaded succesfully */
+    BOT_BYE,        /* bot could not be loaded (host exits) */
+    BOT_RESULT,     /* result of a BOT_MOVE request */
+    BOT_SAY         /* outgoing chat message */
+};
+
+struct BotMessage
+{
+    int type;                       /* one of BotMessageType */
+    int n, timestamp;               /* WATCH, LINE (n only), MOVE */
+    int generation;                 /* MOVE, RESULT */
+    int move;                       /* WATCH, RESULT */
+    double move_rate, turn_rate;    /* WATCH */
+    double latency;                 /* RESULT */
+    int solid;                      /* WATCH */
+    Position p, q;                  /* WATCH, LINE */
+    Rect rect;                      /* LINE */
+    GameParameters gp;              /* RESTART */
+    char name[BOT_NAME_MAX];        /* LISTEN */
+    char text[BOT_TEXT_MAX];        /* LISTEN, SAY */
+};
+
+struct BotRing
+{
+    unsigned head;                  /* next slot to read (consumer only) */
+    char pad1[60];
+    unsigned tail;                  /* next slot to write (producer only) */
+    char pad2[60];
+    BotMessage slots[BOT_RING_SIZE];
+};
+
+struct BotShared
+{
+    BotRing requests;
+    BotRing responses;
+
+    /* Player list for the current BOT_MOVE request; written by the client
+       only while no request is outstanding. */
+    int num_players;
+    Player players[BOT_MAX_PLAYERS];
+    char names[BOT_MAX_PLAYERS][BOT_NAME_MAX];
+};
+
+/* Appends a message to the ring; returns false if the ring is full. */
+inline bool bot_ring_push(BotRing *ring, const BotMessage &msg)
+{
+    unsigned tail = ring->tail;
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == BOT_RING_SIZE)
+    {
+        return false;
+    }
+    ring->slots[tail%BOT_RING_SIZE] = msg;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Removes the first message from the ring; returns false if it is empty. */
+inline bool bot_ring_pop(BotRing *ring, BotMessage *msg)
+{
+    unsigned head = ring->head;
+    if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) return false;
+    *msg = ring->slots[head%BOT_RING_SIZE];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Wakes up the other side after pushing messages. The pipe is non-blocking;
+   if it is full, the other side has plenty of wake-ups pending already. */
+inline void bot_notify(int fd)
+{
+    char c = 0;
+    if (write(fd, &c, 1) < 0) { /* ignored */ }
+}
+
+/* Waits up to `timeout' milliseconds (or indefinitely, if negative) for a
+   notification. Returns 1 if notified, 0 on time-out, or -1 if the other
+   side has closed its end of the pipe. */
+inline int bot_wait(int fd, int timeout)
+{
+    struct pollfd pfd;
+    pfd.fd      = fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    int res = poll(&pfd, 1, timeout);
+    if (res < 0) return errno == EINTR ? 0 : -1;
+    if (res == 0) return 0;
+
+    /* Drain pending notifications */
+    char buf[256];
+    for (;;)
+    {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len == 0) return -1;
+        if (len < 0) return (errno == EAGAIN || errno == EINTR) ? 1 : -1;
+    }
+}
+
+#endif /* ndef BOT_SHM_H_INCLUDED */
@@ -0,0 +1,245 @@
+#include "BotThread.h"
+#include "common.h"
+#include <string.h>
+#include <sys/time.h>
+
+BotThread::BotThread(PlayerController *pc)
+    : m_pc(pc), m_stop(false), m_pending(false), m_has_result(false),
+      m_result(MOVE_FORWARD), m_latency(0), m_generation(0), m_line_width(0)
+{
+    memset(m_field, 0, sizeof(m_field));
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond_event, NULL);
+    pthread_cond_init(&m_cond_result, NULL);
+    if (pthread_create(&m_thread, NULL, thread_main, this) != 0)
+    {
+        fatal("could not create bot thread");
+    }
+}
+
+BotThread::~BotThread()
+{
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_signal(&m_cond_event);
+    pthread_mutex_unlock(&m_mutex);
+    pthread_join(m_thread, NULL);
+    pthread_cond_destroy(&m_cond_result);
+    pthread_cond_destroy(&m_cond_event);
+    pthread_mutex_destroy(&m_mutex);
+}
+
+void BotThread::post(const Event &ev)
+{
+    pthread_mutex_lock(&m_mutex);
+    m_events.push_back(ev);
+    pthread_cond_signal(&m_cond_event);
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void BotThread::restart(const GameParameters &gp)
+{
+    Event ev;
+    ev.type = Event::RESTART;
+    ev.gp   = gp;
+
+    /* Events and results from the previous game are no longer needed */
+    pthread_mutex_lock(&m_mutex);
+    m_events.clear();
+    m_has_result = false;
+    m_pending = false;
+    ++m_generation;
+    pthread_mutex_unlock(&m_mutex);
+
+    post(ev);
+}
+
+void BotThread::drawLine(const Position &p, const Position &q, int n)
+{
+    Event ev;
+    ev.type = Event::LINE;
+    ev.p    = p;
+    ev.q    = q;
+    ev.n    = n;
+    post(ev);
+}
+
+void BotThread::watch_player( int player_index, int timestamp, Move move,
+    double move_rate, double turn_rate, bool solid,
+    const Position &old_pos, const Position &new_pos )
+{
+    Event ev;
+    ev.type      = Event::WATCH;
+    ev.n         = player_index;
+    ev.timestamp = timestamp;
+    ev.move      = move;
+    ev.move_rate = move_rate;
+    ev.turn_rate = turn_rate;
+    ev.solid     = solid;
+    ev.p         = old_pos;
+    ev.q         = new_pos;
+    post(ev);
+}
+
+void BotThread::listen(const std::string &name, const std::string &text)
+{
+    Event ev;
+    ev.type = Event::LISTEN;
+    ev.name = name;
+    ev.text = text;
+    post(ev);
+}
+
+bool BotThread::request_move( int timestamp, const std::vector<Player> &players,
+                              int player_index )
+{
+    pthread_mutex_lock(&m_mutex);
+    bool busy = m_pending || m_has_result;
+    if (!busy) m_pending = true;
+    int generation = m_generation;
+    pthread_mutex_unlock(&m_mutex);
+    if (busy) return false;
+
+    Event ev;
+    ev.type       = Event::MOVE;
+    ev.timestamp  = timestamp;
+    ev.n          = player_index;
+    ev.players    = players;
+    ev.generation = generation;
+
+    /* Player names point into client data that may change; copy them. */
+    for (size_t n = 0; n < players.size(); ++n)
+    {
+        ev.names.push_back(players[n].name != NULL ? players[n].name : "");
+    }
+
+    post(ev);
+    return true;
+}
+
+bool BotThread::wait_move(double timeout, Move *move, double *latency)
+{
+    pthread_mutex_lock(&m_mutex);
+    if (!m_has_result && m_pending && timeout > 0)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        double t = tv.tv_sec + 1e-6*tv.tv_usec + timeout;
+        struct timespec ts;
+        ts.tv_sec  = (time_t)t;
+        ts.tv_nsec = (long)(1e9*(t - (double)ts.tv_sec));
+        while (!m_has_result && m_pending)
+        {
+            if (pthread_cond_timedwait(&m_cond_result, &m_mutex, &ts) != 0)
+            {
+                break;
+            }
+        }
+    }
+    bool res = m_has_result;
+    if (res)
+    {
+        *move    = m_result;
+        *latency = m_latency;
+        m_has_result = false;
+    }
+    pthread_mutex_unlock(&m_mutex);
+    return res;
+}
+
+bool BotThread::retrieve_message(std::string *text)
+{
+    pthread_mutex_lock(&m_mutex);
+    bool res = !m_messages.empty();
+    if (res)
+    {
+        if (text != NULL) *text = m_messages.front();
+        m_messages.pop_front();
+    }
+    pthread_mutex_unlock(&m_mutex);
+    return res;
+}
+
+void *BotThread::thread_main(void *arg)
+{
+    ((BotThread*)arg)->run();
+    return NULL;
+}
+
+void BotThread::run()
+{
+    pthread_mutex_lock(&m_mutex);
+    while (!m_stop)
+    {
+        if (m_events.empty())
+        {
+            pthread_cond_wait(&m_cond_event, &m_mutex);
+            continue;
+        }
+
+        Event ev = m_events.front();
+        m_events.pop_front();
+        pthread_mutex_unlock(&m_mutex);
+        process(ev);
+        pthread_mutex_lock(&m_mutex);
+
+        /* Pass on chat messages queued by the controller */
+        std::string text;
+        while (m_pc->retrieve_message(&text)) m_messages.push_back(text);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void BotThread::process(Event &ev)
+{
+    switch (ev.type)
+    {
+    case Event::RESTART:
+        memset(m_field, 0, sizeof(m_field));
+        m_changes.clear();
+        m_line_width = ev.gp.line_width;
+        m_pc->restart(ev.gp);
+        break;
+
+    case Event::LINE:
+        {
+            FieldChange fc = { ev.n, ev.p, ev.q, Rect() };
+            field_line_th( &m_field, &ev.p, &ev.q, FIELD_SIZE*m_line_width,
+                           ev.n + 1, &fc.rect );
+            m_changes.push_back(fc);
+        } break;
+
+    case Event::WATCH:
+        m_pc->watch_player( ev.n, ev.timestamp, ev.move, ev.move_rate,
+                            ev.turn_rate, ev.solid, ev.p, ev.q );
+        break;
+
+    case Event::LISTEN:
+        m_pc->listen(ev.name, ev.text);
+        break;
+
+    case Event::MOVE:
+        {
+            for (size_t n = 0; n < ev.players.size(); ++n)
+            {
+                ev.players[n].name = ev.names[n].c_str();
+            }
+            double t = time_now();
+            m_pc->field_changed(m_changes);
+            m_changes.clear();
+            Move m = m_pc->move(ev.timestamp, &ev.players[0], ev.n, m_field);
+            t = time_now() - t;
+
+            pthread_mutex_lock(&m_mutex);
+            if (ev.generation == m_generation)
+            {
+                m_result     = m;
+                m_latency    = t;
+                m_has_result = true;
+                m_pending    = false;
+                pthread_cond_signal(&m_cond_result);
+            }
+            pthread_mutex_unlock(&m_mutex);
+        } break;
+    }
+}
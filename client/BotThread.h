@@ -0,0 +1,81 @@
+#ifndef BOT_THREAD_H_INCLUDED
+#define BOT_THREAD_H_INCLUDED
+
+#include "AsyncController.h"
+#include <deque>
+#include <pthread.h>
+
+/* Runs a player controller on a dedicated worker thread.
+
+   The worker keeps a private copy of the game field, which is updated by
+   replaying the line segments drawn by the client in the same order. Since
+   events are delivered in order, the controller always sees the field exactly
+   as it was when its move was requested, while the client goes on drawing new
+   moves and handling input.
+*/
+class BotThread : public AsyncController
+{
+public:
+    explicit BotThread(PlayerController *pc);
+    ~BotThread();
+
+    void restart(const GameParameters &gp);
+    void watch_player( int player_index, int timestamp, Move move,
+        double move_rate, double turn_rate, bool solid,
+        const Position &old_pos, const Position &new_pos );
+    void listen(const std::string &name, const std::string &text);
+    void drawLine(const Position &p, const Position &q, int n);
+    bool request_move( int timestamp, const std::vector<Player> &players,
+                       int player_index );
+    bool wait_move(double timeout, Move *move, double *latency);
+    bool retrieve_message(std::string *text);
+
+private:
+    struct Event
+    {
+        enum Type { RESTART, LINE, WATCH, LISTEN, MOVE } type;
+
+        GameParameters gp;                  /* RESTART */
+        int n, timestamp;                   /* LINE, WATCH, MOVE */
+        Move move;                          /* WATCH */
+        double move_rate, turn_rate;        /* WATCH */
+        bool solid;                         /* WATCH */
+        Position p, q;                      /* LINE, WATCH */
+        std::string name, text;             /* LISTEN */
+        std::vector<Player> players;        /* MOVE */
+        std::vector<std::string> names;     /* MOVE */
+        int generation;                     /* MOVE */
+    };
+
+    static void *thread_main(void *arg);
+    void run();
+    void post(const Event &ev);
+    void process(Event &ev);
+
+    BotThread(const BotThread &);
+    BotThread &operator=(const BotThread &);
+
+private:
+    PlayerController *m_pc;
+    pthread_t m_thread;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond_event;    /* signalled when an event is posted */
+    pthread_cond_t m_cond_result;   /* signalled when a move is calculated */
+
+    /* Shared state (protected by m_mutex) */
+    bool m_stop;                    /* worker thread should exit */
+    std::deque<Event> m_events;     /* events to be processed */
+    bool m_pending;                 /* move request outstanding? */
+    bool m_has_result;              /* move calculated but not retrieved? */
+    Move m_result;                  /* last move calculated */
+    double m_latency;               /* time taken to calculate m_result */
+    int m_generation;               /* incremented on restart */
+    std::deque<std::string> m_messages;
+
+    /* Worker thread state */
+    double m_line_width;
+    Field m_field;
+    std::vector<FieldChange> m_changes;     /* lines drawn since last move */
+};
+
+#endif /* ndef BOT_THREAD_H_INCLUDED */
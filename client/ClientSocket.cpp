@@ -25,6 +25,9 @@ typedef int socklen_t;
 #define close(s) closesocket(s)
 #endif
 
+#define MAX_PACKET_LEN     (16384)  /* largest packet the server sends */
+#define STREAM_BUFFER_SIZE (4*(MAX_PACKET_LEN + 2))
+
 /* For debugging: simulated probability of packet loss (between 0 and 1)
                   (applies only to unreliable packet data) */
 static double g_packetloss;
@@ -56,8 +59,14 @@ static int ip_connect(sockaddr_in &sa_local, sockaddr_in &sa_remote, bool reliab
 }
 
 ClientSocket::ClientSocket(const char *hostname, int port, bool reliable_only)
-    : fd_stream(INVALID_SOCKET), fd_packet(INVALID_SOCKET), stream_pos(0)
+    : fd_stream(INVALID_SOCKET), fd_packet(INVALID_SOCKET)
 {
+    memset(&stream, 0, sizeof(stream));
+    packet_buf = (unsigned char*)malloc(MAX_PACKET_LEN);
+    if (packet_buf == NULL || !packet_buffer_init(&stream, STREAM_BUFFER_SIZE))
+    {
+        fatal("out of memory");
+    }
     clear_stats();
 
 #ifdef WIN32
@@ -141,6 +150,8 @@ ClientSocket::~ClientSocket()
     {
         close(fd_packet);
     }
+    packet_buffer_free(&stream);
+    free(packet_buf);
 }
 
 bool ClientSocket::connected() const
@@ -182,42 +193,30 @@ void ClientSocket::write(void const *buf, size_t len, bool reliable)
     }
 }
 
-ssize_t ClientSocket::next_stream_packet(void *buf, size_t buf_len)
+ssize_t ClientSocket::next_stream_packet(unsigned char **data)
 {
-    if (stream_pos < 2) return 0;
-
-    size_t len = 256*stream_buf[0] + stream_buf[1];
-    if (len > sizeof(stream_buf) - 2)
+    size_t len;
+    switch (packet_buffer_next(&stream, MAX_PACKET_LEN, data, &len))
     {
-        error("ClientSocket::read(): packet too large");
-        return -1;
-    }
+    case 0:
+        return 0;
 
-    if (len < 1)
-    {
-        error("ClientSocket::read(): packet too small");
-        return -1;
-    }
+    case 1:
+        ++packets_received;
+        bytes_received += len;
+        return len;
 
-    if (stream_pos < len + 2)
-    {
-        /* Packet not yet complete. */
-        return 0;
+    default:
+        error("ClientSocket::read(): invalid packet length");
+        return -1;
     }
-
-    /* Decode packet */
-    if (len > buf_len) fatal("ClientSocket::read(): buffer too small");
-    memcpy(buf, stream_buf + 2, len);
-    memmove(stream_buf, stream_buf + len + 2, stream_pos - (len + 2));
-    stream_pos -= len + 2;
-    return len;
 }
 
-ssize_t ClientSocket::read(void *buf, size_t buf_len)
+ssize_t ClientSocket::read(unsigned char **data)
 {
     /* First, check if we have a buffered packet available */
     {
-        ssize_t res = next_stream_packet(buf, buf_len);
+        ssize_t res = next_stream_packet(data);
         if (res != 0) return res;
     }
 
@@ -247,34 +246,38 @@ ssize_t ClientSocket::read(void *buf, size_t buf_len)
 
     if (fd_stream != INVALID_SOCKET && FD_ISSET(fd_stream, &readfds))
     {
-        ssize_t len = recv(fd_stream, stream_buf + stream_pos,
-                                      sizeof(stream_buf) - stream_pos, 0);
+        /* Receive as much as fits in the buffer */
+        size_t space;
+        unsigned char *buf = packet_buffer_space(&stream, &space);
+        ssize_t len = recv(fd_stream, buf, space, 0);
         if (len < 0)
         {
-            error("recv() failed  %d", stream_pos);
+            error("recv() failed");
             return -1;
         }
-        stream_pos += len;
-        ssize_t res = next_stream_packet(buf, buf_len);
-        if (res != 0)
+        if (len == 0)
         {
-            ++packets_received;
-            bytes_received += res;
-            return res;
+            error("connection closed by server");
+            return -1;
         }
+        packet_buffer_commit(&stream, len);
+        ssize_t res = next_stream_packet(data);
+        if (res != 0) return res;
     }
 
     if (fd_packet != INVALID_SOCKET && FD_ISSET(fd_packet, &readfds))
     {
-        ssize_t res = recv(fd_packet, buf, buf_len, 0);
+        ssize_t res = recv(fd_packet, packet_buf, MAX_PACKET_LEN, 0);
 
         /* Randomly drop incoming packet */
         if (g_packetloss != 0 && rand() < RAND_MAX*g_packetloss) res = 0;
 
-        if (res != 0)
+        if (res < 0) warn("unreliable recv() failed");
+        if (res > 0)
         {
             ++packets_received;
             bytes_received += res;
+            *data = packet_buf;
             return res;
         }
     }
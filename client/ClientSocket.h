@@ -2,6 +2,7 @@
 #define CLIENT_SOCKET_H_INCLUDED
 
 #include <stdlib.h>
+#include "../common/PacketBuffer.h"
 
 #ifdef _MSC_VER
 typedef int ssize_t;
@@ -26,9 +27,17 @@ public:
     bool connected() const;
     bool reliable_only() const { return fd_packet == INVALID_SOCKET; }
 
+    /* Sockets to watch for incoming data (INVALID_SOCKET if unused) */
+    SOCKET stream_socket() const { return fd_stream; }
+    SOCKET packet_socket() const { return fd_packet; }
+
     /* Streaming (reliable) messaging */
     void write(void const *buf, size_t len, bool reliable);
-    ssize_t read(void *buf, size_t len);
+
+    /* Retrieves the next packet received (if any) and returns its length,
+       or 0 if none is available, or -1 on error. The packet data is stored
+       in the socket's buffers and remains valid until the next call. */
+    ssize_t read(unsigned char **data);
 
     /* Functions to collect network traffic statistics: */
     void clear_stats();
@@ -42,14 +51,14 @@ public:
 
 protected:
     /* reads the next available packet from the stream buffer (if any) */
-    ssize_t next_stream_packet(void *buf, size_t buf_len);
+    ssize_t next_stream_packet(unsigned char **data);
 
 private:
     SOCKET fd_stream;
     SOCKET fd_packet;
 
-    unsigned char stream_buf[4096];
-    size_t stream_pos;
+    PacketBuffer stream;                    /* received stream data */
+    unsigned char *packet_buf;              /* last datagram */
 
     size_t bytes_sent, bytes_received, packets_sent, packets_received;
 };
@@ -0,0 +1,125 @@
+#include "ClockSync.h"
+#include <math.h>
+
+/* Bounds on the lead time */
+static const double min_lead = 0.002;
+static const int max_lead_frames = 10;
+
+/* Lead adjustments: grow by a quarter frame when a move arrives late, and
+   shrink by half a millisecond per second of moves arriving in time */
+static const double late_step    = 0.25;
+static const double in_time_step = 0.0005;
+
+/* Maximum estimated clock drift (relative to the nominal frame rate) */
+static const double max_drift = 1e-3;
+
+ClockSync::ClockSync()
+{
+    reset(1);
+}
+
+void ClockSync::reset(double rate)
+{
+    m_rate    = rate > 0 ? rate : 1;
+    m_drift   = 0;
+    m_lead    = 1/m_rate;
+    m_in_time = 0;
+    m_windows = 0;
+}
+
+void ClockSync::frame_received(int timestamp, double t)
+{
+    double offset = t - timestamp/m_rate;
+    int window = timestamp/WINDOW;
+    int current = m_windows > 0 ? m_min[(m_windows - 1)%WINDOWS].timestamp/WINDOW
+                                : -1;
+
+    if (window > current)
+    {
+        /* Start a new window */
+        Sample &s = m_min[m_windows%WINDOWS];
+        s.timestamp = timestamp;
+        s.offset    = offset;
+        ++m_windows;
+        update_drift();
+    }
+    else
+    {
+        Sample &s = m_min[(m_windows - 1)%WINDOWS];
+        if (offset < s.offset)
+        {
+            s.timestamp = timestamp;
+            s.offset    = offset;
+        }
+    }
+}
+
+void ClockSync::move_processed(int timestamp, int server_timestamp)
+{
+    /* The first move can never be in time, since moves are only sent after
+       the first frame is received. */
+    if (timestamp == 0) return;
+
+    if (server_timestamp > timestamp + 1)
+    {
+        m_lead += late_step/m_rate;
+        if (m_lead > max_lead_frames/m_rate) m_lead = max_lead_frames/m_rate;
+        m_in_time = 0;
+    }
+    else
+    if (++m_in_time >= m_rate)
+    {
+        m_lead -= in_time_step;
+        if (m_lead < min_lead) m_lead = min_lead;
+        m_in_time = 0;
+    }
+}
+
+void ClockSync::update_drift()
+{
+    /* Fit a line through the minima of the completed windows */
+    int count = m_windows - 1 < WINDOWS - 1 ? m_windows - 1 : WINDOWS - 1;
+    if (count < 3)
+    {
+        m_drift = 0;
+        return;
+    }
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const Sample &s = m_min[(m_windows - 2 - i)%WINDOWS];
+        sx  += s.timestamp;
+        sy  += s.offset;
+        sxx += (double)s.timestamp*s.timestamp;
+        sxy += s.timestamp*s.offset;
+    }
+    double var = count*sxx - sx*sx;
+    m_drift = var > 0 ? (count*sxy - sx*sy)/var : 0;
+    if (m_drift >  max_drift/m_rate) m_drift =  max_drift/m_rate;
+    if (m_drift < -max_drift/m_rate) m_drift = -max_drift/m_rate;
+}
+
+double ClockSync::arrival_time(int timestamp) const
+{
+    /* Lower envelope of the window minima, extrapolated with the drift */
+    int count = m_windows < WINDOWS ? m_windows : WINDOWS;
+    double offset = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const Sample &s = m_min[(m_windows - 1 - i)%WINDOWS];
+        double o = s.offset + m_drift*(timestamp - s.timestamp);
+        if (i == 0 || o < offset) offset = o;
+    }
+    return offset + timestamp/m_rate;
+}
+
+int ClockSync::send_timestamp(double t) const
+{
+    return (int)floor((t + m_lead - arrival_time(0))/(1/m_rate + m_drift));
+}
+
+double ClockSync::send_time(int timestamp) const
+{
+    return arrival_time(timestamp + 1) - m_lead;
+}
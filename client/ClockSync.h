@@ -0,0 +1,67 @@
+#ifndef CLOCK_SYNC_H_INCLUDED
+#define CLOCK_SYNC_H_INCLUDED
+
+/* Estimates when the server processes its frames, and when moves should be
+   sent so they arrive just before the server needs them.
+
+   The local time at which the server's frame k is received is modelled as
+   base + k/rate + drift*k plus a non-negative network delay. The base and
+   drift are estimated from the lower envelope of the arrival times (the
+   minimum per window of WINDOW frames over the last WINDOWS windows), so
+   delayed packets are ignored while the estimate still follows slow clock
+   drift in either direction.
+
+   A move for timestamp k is consumed when the server processes frame k + 1,
+   and is sent `lead' seconds before that frame's estimated arrival time.
+   The lead starts at one frame, grows when moves are found to arrive late,
+   and slowly shrinks while they arrive in time, so it settles just above
+   the round-trip time. */
+class ClockSync
+{
+public:
+    ClockSync();
+
+    /* Starts estimating for a new game with the given frame rate. */
+    void reset(double rate);
+
+    /* Records that the server's frame `timestamp' arrived at time `t'. */
+    void frame_received(int timestamp, double t);
+
+    /* Records that the move made at `timestamp' was processed in the
+       server's frame `server_timestamp'. */
+    void move_processed(int timestamp, int server_timestamp);
+
+    /* Returns the number of moves that should have been sent by time `t'
+       (i.e. the timestamp of the first move not yet due). */
+    int send_timestamp(double t) const;
+
+    /* Returns the time at which the move for `timestamp' should be sent. */
+    double send_time(int timestamp) const;
+
+    /* Returns the current lead time (in seconds). */
+    double lead() const { return m_lead; }
+
+private:
+    enum { WINDOW = 64, WINDOWS = 8 };
+
+    /* Minimum offset (arrival time minus nominal frame time) in a window */
+    struct Sample
+    {
+        int timestamp;
+        double offset;
+    };
+
+    /* Returns the estimated arrival time of the server's frame `timestamp' */
+    double arrival_time(int timestamp) const;
+    void update_drift();
+
+private:
+    double m_rate;              /* nominal frames per second */
+    double m_drift;             /* estimated offset change per frame */
+    double m_lead;              /* seconds moves are sent ahead */
+    int m_in_time;              /* consecutive moves processed in time */
+    int m_windows;              /* number of windows started */
+    Sample m_min[WINDOWS];      /* minimum per window (circular) */
+};
+
+#endif /* ndef CLOCK_SYNC_H_INCLUDED */
@@ -18,6 +18,9 @@ Config::Config()
     m_port = 12321;
     m_reliable_only = true;
 
+    m_bot_deadline = 10;
+    m_sandbox_bots = true;
+
     m_num_players = 1;
     m_player_index[0] = 0;
     {
@@ -250,6 +253,19 @@ bool Config::parse_setting(std::string &key, std::string &value, int i, int j)
         return true;
     }
 
+    if (key == "bot_deadline")
+    {
+        m_bot_deadline = atoi(value.c_str());
+        if (m_bot_deadline < 1) m_bot_deadline = 1;
+        return true;
+    }
+
+    if (key == "sandbox_bots")
+    {
+        m_sandbox_bots = (bool)atoi(value.c_str());
+        return true;
+    }
+
     if (key == "names" && (0 <= i && i < 4) && (j == 0))
     {
         m_names[i] = value;
@@ -334,6 +350,8 @@ bool Config::save_settings(const char *path)
     ofs << "hostname=" << m_hostname << '\n';
     ofs << "port=" << m_port << '\n';
     ofs << "tcp_only=" << m_reliable_only << '\n';
+    ofs << "bot_deadline=" << m_bot_deadline << '\n';
+    ofs << "sandbox_bots=" << m_sandbox_bots << '\n';
     for (int p = 0; p < 4; ++p)
     {
         ofs << "names:" << p << '=' << m_names[p] << '\n';
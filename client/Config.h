@@ -18,6 +18,8 @@ public:
     const std::string &hostname() const { return m_hostname; }
     int port() const { return m_port; }
     bool reliable_only() const { return m_reliable_only; }
+    int bot_deadline() const { return m_bot_deadline; }
+    bool sandbox_bots() const { return m_sandbox_bots; }
     int players() const { return m_num_players; }
     const std::string &name(int n) const { return m_names[m_player_index[n]]; }
     int key(int n, int m) const {
@@ -43,6 +45,10 @@ private:
     int m_port;
     bool m_reliable_only;
 
+    /* Bots */
+    int m_bot_deadline;     /* time budget for bot moves (in milliseconds) */
+    bool m_sandbox_bots;    /* run bots in a separate process if possible */
+
     /* Players */
     int m_num_players;
     int m_player_index[4];
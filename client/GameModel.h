@@ -3,6 +3,7 @@
 
 #include <string>
 
+#include "../common/HoleSchedule.h"
 #include "../common/Movement.h"
 #include "../common/Protocol.h"
 
@@ -32,18 +33,23 @@ struct Player
     Position    ppos;           /* predicted position */
     int         pt;             /* predicted timestamp */
     bool        dead;           /* has died? */
-    int         hole;           /* generating a hole */
-    int         solid_since;    /* earliest timestamp after last hole */
+    int         hole;           /* remaining length of hole being generated
+                                   at the last move (or 0) */
     const char  *name;          /* display name */
     int         score_cur;      /* score this round */
     int         score_tot;      /* total score */
     int         score_avg;      /* moving average */
     int         score_holes;    /* number of holes passed through */
-
-    /* Multiply-with-carry RNG for this player
-       (used to determine random state transitions) */
-    unsigned    rng_base;       /* base (current) value */
-    unsigned    rng_carry;      /* last carry value */
 };
 
+/* Returns the hole parameters of the game (see common/HoleSchedule.h); use
+   hole_schedule_init() with the game id and a player's index to determine
+   when that player makes holes. */
+inline HoleParams hole_params(const GameParameters &gp)
+{
+    HoleParams params = { gp.warmup, gp.hole_probability, gp.hole_length_min,
+                          gp.hole_length_max, gp.hole_cooldown };
+    return params;
+}
+
 #endif /* ndef GAME_MODEL_H_INCLUDED */
@@ -20,6 +20,7 @@ void GameView::resize(int x, int y, int w, int h)
     {
         fl_delete_offscreen(offscr);
         offscr_created = false;
+        dirty.clear();
     }
     return Fl_Widget::resize(x, y, w, h);
 }
@@ -27,61 +28,142 @@ void GameView::resize(int x, int y, int w, int h)
 void GameView::renderOffscreen(int x1, int y1, int x2, int y2)
 {
     int w = this->w(), h = this->h();
-    fl_begin_offscreen(offscr);
-    fl_color(FL_BLACK);
-    fl_rectf(x1, h - y2, x2 - x1, y2 - y1);
-    if (antialiasing)
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 > w) x2 = w;
+    if (y2 > h) y2 = h;
+    if (x1 >= x2 || y1 >= y2) return;
+
+    if (image.size() != (size_t)3*w*h) image.assign((size_t)3*w*h, 0);
+
+    /* Field coordinates of the (sub)pixels sampled for each pixel */
+    const int samples = antialiasing ? 3 : 1;
+    if ((int)sample_x.size() != samples*w || (int)sample_y.size() != samples*h)
+    {
+        sample_x.resize(samples*w);
+        sample_y.resize(samples*h);
+        for (int i = 0; i < samples*w; ++i)
+        {
+            sample_x[i] = FIELD_SIZE*i/(samples*w);
+        }
+        for (int i = 0; i < samples*h; ++i)
+        {
+            sample_y[i] = FIELD_SIZE*i/(samples*h);
+        }
+    }
+
+    /* Map field values to colours (0 is empty; n > 0 is drawn by player n) */
+    unsigned char palette[256][3];
+    memset(palette, 0, sizeof(palette));
+    for (size_t n = 0; n < sprites.size() && n < 255; ++n)
+    {
+        Fl_Color c = sprites[n].col;
+        palette[n + 1][0] = (c >> 24)&255;
+        palette[n + 1][1] = (c >> 16)&255;
+        palette[n + 1][2] = (c >>  8)&255;
+    }
+
+    /* Fill in the image (which is stored top-down, unlike the field) */
+    for (int y = y1; y < y2; ++y)
     {
-        for (int y = y1; y < y2; ++y)
+        unsigned char *out = &image[3*((size_t)(h - 1 - y)*w + x1)];
+        if (antialiasing)
         {
-            for (int x = x1; x < x2; ++x)
+            /* Simple anti-aliasing (sample nine subpixels) */
+            const unsigned char *rows[3] = { m_field[sample_y[3*y + 0]],
+                                             m_field[sample_y[3*y + 1]],
+                                             m_field[sample_y[3*y + 2]] };
+            for (int x = x1; x < x2; ++x, out += 3)
             {
-                /* Simple anti-aliasing (sample nine subpixels) */
+                const int *sx = &sample_x[3*x];
+                unsigned char v = rows[0][sx[0]];
+                if ( v == rows[0][sx[1]] && v == rows[0][sx[2]] &&
+                     v == rows[1][sx[0]] && v == rows[1][sx[1]] &&
+                     v == rows[1][sx[2]] && v == rows[2][sx[0]] &&
+                     v == rows[2][sx[1]] && v == rows[2][sx[2]] )
+                {
+                    /* Uniform pixel (most of the field) */
+                    out[0] = palette[v][0];
+                    out[1] = palette[v][1];
+                    out[2] = palette[v][2];
+                    continue;
+                }
+
                 unsigned r = 0, g = 0, b = 0;
                 for (int dy = 0; dy < 3; ++dy)
                 {
                     for (int dx = 0; dx < 3; ++dx)
                     {
-                        int i = m_field [FIELD_SIZE*(3*y + dy)/(3*h)]
-                                        [FIELD_SIZE*(3*x + dx)/(3*w)];
-                        if (i > 0)
-                        {
-                            Fl_Color c = sprites[i - 1].col;
-                            r += (c >> 24)&255;
-                            g += (c >> 16)&255;
-                            b += (c >>  8)&255;
-                        }
+                        const unsigned char *c = palette[rows[dy][sx[dx]]];
+                        r += c[0];
+                        g += c[1];
+                        b += c[2];
                     }
                 }
-
-                if (r + g + b > 0)
-                {
-                    fl_color(fl_rgb_color(r/9, g/9, b/9));
-                    fl_point(x, h - 1 - y);
-                }
+                out[0] = r/9;
+                out[1] = g/9;
+                out[2] = b/9;
             }
         }
-    }
-    else
-    {
-        /* Non anti-aliased display (may render faster) */
-        for (int y = y1; y < y2; ++y)
+        else
         {
-            for (int x = x1; x < x2; ++x)
+            /* Non anti-aliased display (may render faster) */
+            const unsigned char *row = m_field[sample_y[y]];
+            for (int x = x1; x < x2; ++x, out += 3)
             {
-                int n = m_field[FIELD_SIZE*y/h][FIELD_SIZE*x/w];
-                if (n > 0)
-                {
-                    fl_color(n == 0 ? FL_BLACK : sprites[n - 1].col);
-                    fl_point(x, h - 1 - y);
-                }
+                const unsigned char *c = palette[row[sample_x[x]]];
+                out[0] = c[0];
+                out[1] = c[1];
+                out[2] = c[2];
             }
         }
     }
+
+    /* Copy the changed part of the image to the offscreen buffer */
+    fl_begin_offscreen(offscr);
+    fl_draw_image( &image[3*((size_t)(h - y2)*w + x1)],
+                   x1, h - y2, x2 - x1, y2 - y1, 3, 3*w );
     fl_end_offscreen();
+}
 
-//    damage(this->x() + x1, this->y() + h - y2, x2 - x1, y2 - y1, 1);
-    damage(1);
+void GameView::addDirty(int x1, int y1, int x2, int y2)
+{
+    Rect r = { x1, y1, x2, y2 };
+
+    /* Merge with overlapping (or adjacent) regions */
+    for (size_t i = 0; i < dirty.size(); )
+    {
+        const Rect &d = dirty[i];
+        if (d.x1 <= r.x2 && r.x1 <= d.x2 && d.y1 <= r.y2 && r.y1 <= d.y2)
+        {
+            r.x1 = std::min(r.x1, d.x1);
+            r.y1 = std::min(r.y1, d.y1);
+            r.x2 = std::max(r.x2, d.x2);
+            r.y2 = std::max(r.y2, d.y2);
+            dirty.erase(dirty.begin() + i);
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    dirty.push_back(r);
+
+    /* Too many separate regions; merge them all */
+    if (dirty.size() > max_dirty)
+    {
+        for (size_t i = 1; i < dirty.size(); ++i)
+        {
+            r.x1 = std::min(r.x1, dirty[i].x1);
+            r.y1 = std::min(r.y1, dirty[i].y1);
+            r.x2 = std::max(r.x2, dirty[i].x2);
+            r.y2 = std::max(r.y2, dirty[i].y2);
+        }
+        dirty.assign(1, r);
+    }
+
+    damage(1, x() + x1, y() + h() - y2, x2 - x1, y2 - y1);
 }
 
 void GameView::setLineWidth(double lw)
@@ -91,15 +173,19 @@ void GameView::setLineWidth(double lw)
     line_width = lw;
 }
 
-void GameView::drawLine(const Position *p, const Position *q, int n)
+void GameView::drawLine( const Position *p, const Position *q, int n,
+                         Rect *rect )
 {
     Rect r;
     field_line_th(&m_field, p, q, FIELD_SIZE*line_width, n + 1, &r);
+    if (rect != NULL) *rect = r;
 
     int w = this->w(), h = this->h();
     int x1 = r.x1*w/FIELD_SIZE, x2 = (r.x2*w + FIELD_SIZE - 1)/FIELD_SIZE;
     int y1 = r.y1*h/FIELD_SIZE, y2 = (r.y2*h + FIELD_SIZE - 1)/FIELD_SIZE;
-    if (offscr_created) renderOffscreen(x1, y1, x2, y2);
+
+    /* Rendered before the next redraw, together with other lines drawn */
+    if (offscr_created && x1 < x2 && y1 < y2) addDirty(x1, y1, x2, y2);
 }
 
 void GameView::draw()
@@ -110,11 +196,19 @@ void GameView::draw()
     {
         offscr = fl_create_offscreen(w(), h());
         offscr_created = true;
+        dirty.clear();
         renderOffscreen(0, 0, w(), h());
     }
+    for (size_t i = 0; i < dirty.size(); ++i)
+    {
+        renderOffscreen(dirty[i].x1, dirty[i].y1, dirty[i].x2, dirty[i].y2);
+    }
+    dirty.clear();
 
-    /* Draw background */
-    fl_copy_offscreen(x(), y(), w(), h(), offscr, 0, 0);
+    /* Draw background (only the damaged part) */
+    int cx, cy, cw, ch;
+    fl_clip_box(x(), y(), w(), h(), cx, cy, cw, ch);
+    fl_copy_offscreen(cx, cy, cw, ch, offscr, cx - x(), cy - y());
 
     /* Draw bounding rectangle */
     fl_color(fl_gray_ramp(FL_NUM_GRAY/2));
@@ -171,7 +265,9 @@ void GameView::draw()
 
 void GameView::damageSprite(int n)
 {
-    damage(1, x() + sprites[n].x - 16, y() + sprites[n].y - 16, 32, 32);
+    /* Sprites extend at most 2 line widths from their position */
+    int r = std::max(16, (int)(2*line_width*w()) + 2);
+    damage(1, x() + sprites[n].x - r, y() + sprites[n].y - r, 2*r, 2*r);
 
     if (!sprites[n].label.empty())
     {
@@ -179,8 +275,8 @@ void GameView::damageSprite(int n)
         int font_size = this->w()/50 + 1;
         fl_font(FL_HELVETICA, font_size);
         fl_measure(sprites[n].label.c_str(), w, h, 0);
-        // damage(1, x() + sprites[n].x - w/2 - 4, y() + sprites[n].y + 6, w + 8, 24);
-        damage(1);
+        damage( 1, x() + sprites[n].x - w/2 - 4,
+                y() + sprites[n].y + font_size - 4, w + 8, 2*font_size + 8 );
     }
 }
 
@@ -224,6 +320,8 @@ void GameView::clear()
         fl_rectf(0, 0, w(), h());
         fl_end_offscreen();
     }
+    dirty.clear();
+    std::fill(image.begin(), image.end(), 0);
     memset(&m_field, 0, sizeof(m_field));
     damage(1);
 }
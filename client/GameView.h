@@ -29,7 +29,8 @@ public:
 
     void renderOffscreen(int x1, int y1, int x2, int y2);
     void setLineWidth(double lw);
-    void drawLine(const Position *p, const Position *q, int n);
+    void drawLine( const Position *p, const Position *q, int n,
+                   Rect *rect = NULL );
 
     Fl_Color spriteColor(int n) { return sprites[n].col; };
     Sprite::SpriteType spriteType(int n) { return sprites[n].type; }
@@ -52,12 +53,20 @@ protected:
     void useOffscreen();
     void draw();
     void damageSprite(int n);
+    void addDirty(int x1, int y1, int x2, int y2);
 
 private:
     const bool antialiasing;
     double line_width;
     bool offscr_created;
     Fl_Offscreen offscr;
+    std::vector<Rect> dirty;            /* regions (in pixels, bottom-up) to
+                                           render before the next redraw */
+    static const size_t max_dirty = 16;
+    std::vector<unsigned char> image;   /* RGB image of the field (top-down),
+                                           copied to the offscreen buffer */
+    std::vector<int> sample_x, sample_y;    /* field coordinates sampled per
+                                               (sub)pixel column and row */
     std::vector<Sprite> sprites;
     Field m_field;
 };
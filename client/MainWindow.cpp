@@ -24,6 +24,11 @@ MainWindow::MainWindow( int width, int height,
     net_box->labelsize(12);
     net_box->labelcolor(fl_gray_ramp(2*FL_NUM_GRAY/3));
     net_box->align(FL_ALIGN_INSIDE);
+    bot_box = new Fl_Box(height, height - 140, width - height, 60);
+    bot_box->labelfont(FL_HELVETICA);
+    bot_box->labelsize(12);
+    bot_box->labelcolor(fl_gray_ramp(2*FL_NUM_GRAY/3));
+    bot_box->align(FL_ALIGN_INSIDE);
     end();
     if (fullscreen)
     {
@@ -60,6 +65,7 @@ void MainWindow::resize(int x, int y, int w, int h)
     gid_box->resize(gv_size, h - 20, w - gv_size, 20);
     fps_box->resize(gv_size, h - 40, w - gv_size, 20);
     net_box->resize(gv_size, h - 80, w - gv_size, 40);
+    bot_box->resize(gv_size, h - 140, w - gv_size, 60);
     return Fl_Double_Window::resize(x, y, w, h);
 }
 
@@ -85,6 +91,12 @@ void MainWindow::setTrafficStats( int bytes_in, int packets_in,
     net_box->label(net_box_label);
 }
 
+void MainWindow::setBotStats(const char *text)
+{
+    snprintf(bot_box_label, sizeof(bot_box_label), "%s", text);
+    bot_box->label(bot_box_label);
+}
+
 void MainWindow::resetGameView(int players, double line_width)
 {
     gv->clear();
@@ -18,6 +18,7 @@ public:
     void setFPS(double fps);
     void setTrafficStats( int bytes_in, int packets_in,
                           int bytes_out, int packets_out );
+    void setBotStats(const char *text);
     void resetGameView(int players, double line_width);
 
 private:
@@ -26,10 +27,12 @@ private:
     Fl_Box *gid_box;        /* box displaying the current game id */
     Fl_Box *fps_box;        /* box displaying the rendering framerate */
     Fl_Box *net_box;        /* box displaying inbound traffic stats */
+    Fl_Box *bot_box;        /* box displaying bot move timing stats */
 
     char gid_box_label[32];   /* buffer for gid_box label */
     char fps_box_label[32];   /* buffer for fps_box label */
     char net_box_label[64];   /* buffer for inbound traffic label */
+    char bot_box_label[256];  /* buffer for bot timing label */
 };
 
 #endif /* ndef MAINWINDOW_H_INCLUDED */
@@ -1,8 +1,13 @@
 #include "PlayerController.h"
-#include "common.h"
+#include <common/Debug.h>
 #include <string.h>
 #include <stdio.h>
 
+/* This file does not depend on FLTK, so the server can load bots too. */
+#ifdef WIN32
+#include <windows.h>
+#endif
+
 #ifndef WIN32
 #include <dlfcn.h>
 static PlayerController *load_bot_posix(const char *name)
@@ -72,9 +77,18 @@ static PlayerController *load_bot_win32(const char *name)
 
 PlayerController *PlayerController::load_bot(const char *name)
 {
+    std::string bot = bot_name(name);
 #ifdef WIN32
-    return load_bot_win32(name);
+    return load_bot_win32(bot.c_str());
 #else
-    return load_bot_posix(name);
+    return load_bot_posix(bot.c_str());
 #endif
 }
+
+std::string PlayerController::bot_name(const std::string &name)
+{
+    size_t pos = name.find_last_not_of("0123456789");
+    if ( pos == std::string::npos || pos == 0 || pos + 1 == name.size() ||
+         name[pos] != '-' ) return name;
+    return name.substr(0, pos);
+}
@@ -3,15 +3,31 @@
 
 #include <string>
 #include <deque>
+#include <vector>
 #include <common/Field.h>
 #include "GameModel.h"
 
+/* A line segment drawn on the game field. If player_index is -1, the
+   segment is not a line, and any part of the field in `rect' may have
+   changed (e.g. after a bot host restarted in the middle of a game). */
+struct FieldChange
+{
+    int player_index;           /* player that drew the segment (or -1) */
+    Position p, q;              /* end points of the segment */
+    Rect rect;                  /* pixels affected (see field_line_th()) */
+};
+
 class PlayerController
 {
 public:
     /* Attempts to load a bot using the given name as a filename hint: */
     static PlayerController *load_bot(const char *name);
 
+    /* Returns the name of the bot that a player name refers to. Player names
+       may end in a dash followed by digits (e.g. "Squad-2"), so that several
+       players can use the same bot. */
+    static std::string bot_name(const std::string &name);
+
 public:
     PlayerController(bool human = false) : m_human(human) { };
     virtual ~PlayerController() { };
@@ -41,6 +57,20 @@ public:
     virtual Move move( int timestamp, const Player *players,
                        int player_index, const Field &field ) = 0;
 
+    /* Determines moves for `count' players at once: `player_indices' are
+       their indices into `players', and the moves are stored in `moves'.
+       This is called instead of move() for batched controllers (see below).
+       The default implementation calls move() for each player. */
+    virtual void move_batch( int timestamp, const Player *players,
+                             const int *player_indices, int count,
+                             const Field &field, Move *moves )
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            moves[i] = move(timestamp, players, player_indices[i], field);
+        }
+    }
+
     /* Handle a chat message. */
     virtual void listen(std::string &name, std::string &text)
     {
@@ -63,6 +93,15 @@ public:
         (void)new_pos;
     }
 
+    /* Called just before move() with the line segments drawn on the field
+       since the previous call to move() (or since restart()), in the order
+       in which they were drawn. Controllers that keep data derived from the
+       field can use this to update it incrementally. */
+    virtual void field_changed(const std::vector<FieldChange> &changes)
+    {
+        (void)changes;
+    }
+
     /* Call this method to queue an outgoing chat message */
     void say(const std::string &text)
     {
@@ -81,6 +120,19 @@ public:
     /* Returns whether this player is human */
     bool human() { return m_human; }
 
+    /* Returns whether the controller may run on a worker thread. Controllers
+       that do so must not call FLTK functions (e.g. to read keys or to update
+       a window), and are passed a private copy of the field. */
+    virtual bool threaded() { return false; }
+
+    /* Returns whether the controller calculates moves in batches. Local
+       players that use the same batched bot share a single instance, which
+       runs on the client thread: work that does not depend on the player
+       (e.g. updating data derived from the field) is then done only once
+       per frame. restart(), watch_player(), field_changed() and listen()
+       are called once for the instance, not for each of its players. */
+    virtual bool batched() { return false; }
+
 private:
     bool m_human;
     std::deque<std::string> m_messages;
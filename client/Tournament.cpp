@@ -0,0 +1,436 @@
+/* Headless bot tournament runner.
+
+   Plays many matches between bots (loaded from bots/NAME.so, just like the
+   client does) without a server or GUI, spreading matches over all CPU cores.
+   Bots that may not run on worker threads (see PlayerController::threaded())
+   restrict the tournament to the main thread.
+   Game rules follow the server's defaults. Reports per-bot win rates,
+   survival time and move() decision latency percentiles. */
+
+#include "PlayerController.h"
+#include <common/Debug.h>
+#include <common/Field.h>
+#include <common/Movement.h>
+#include <common/Time.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Game parameters (server defaults) */
+static const int FPS              = 30;
+static const int TURN_RATE        = 48;
+static const int MOVE_RATE        = 6;
+static const int LINE_WIDTH       = 7;
+static const int HOLE_PROBABILITY = 60;
+static const int HOLE_LENGTH_MIN  = 3;
+static const int HOLE_LENGTH_MAX  = 8;
+static const int HOLE_COOLDOWN    = 10;
+static const int WARMUP_TIME      = 3*FPS;
+static const int VICTORY_TIME     = 3*FPS;
+
+/* Latency histogram: bucket b covers [2^(b/8), 2^((b+1)/8)) microseconds */
+#define LATENCY_BUCKETS (8*32)
+
+/* Tournament configuration (set from the command line) */
+static int g_matches     = 100;
+static int g_players     = 0;       /* players per match (0: all bots) */
+static int g_threads     = 0;       /* worker threads (0: number of CPUs) */
+static int g_max_seconds = 600;     /* maximum match length (game time) */
+static unsigned g_seed   = 1;
+static std::vector<std::string> g_bot_names;
+
+/* Accumulated results per bot */
+struct BotStats
+{
+    BotStats() : matches(), wins(), points(), survival(), moves(), latency() { }
+
+    int matches;                        /* matches played */
+    int wins;                           /* matches won outright */
+    long long points;                   /* total points scored */
+    long long survival;                 /* frames survived after warmup */
+    long long moves;                    /* move() calls made */
+    long long latency[LATENCY_BUCKETS]; /* move() latency histogram */
+};
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_next_match;                /* next match to be played */
+static std::vector<BotStats> g_stats;   /* indexed like g_bot_names */
+
+/* Per-match random number generator (multiply-with-carry, as in the game) */
+struct Random
+{
+    explicit Random(unsigned seed) : base(seed ? seed : 1), carry() { }
+
+    unsigned next()
+    {
+        unsigned long long next = base*1967773755ull + carry;
+        base  = next&0xffffffff;
+        carry = next>>32;
+        return base;
+    }
+
+    int range(int lo, int hi) { return lo + (int)(next()%(hi - lo + 1)); }
+
+    unsigned base, carry;
+};
+
+/* State of a player in a match that is not visible to bots */
+struct Seat
+{
+    int bot;                /* index into g_bot_names */
+    PlayerController *pc;   /* controller instance for this match */
+    bool has_moved;         /* did player turn during warmup? */
+    int dead_since;         /* timestamp of death (or -1 if alive) */
+    int score;              /* points scored in this match */
+    HoleSchedule holes;     /* when the player makes holes */
+    std::vector<FieldChange> changes;   /* lines drawn since last move */
+};
+
+static int latency_bucket(double seconds)
+{
+    double us = 1e6*seconds;
+    if (us < 1) return 0;
+    int b = (int)(8*log2(us)) + 1;
+    return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+}
+
+static double latency_bucket_limit(int b)
+{
+    return b == 0 ? 1 : pow(2.0, b/8.0);
+}
+
+/* Kills player `n' at `timestamp', awarding points to the survivors. */
+static void kill_player( std::vector<Seat> &seats, std::vector<Player> &players,
+                         int n, int timestamp, int *alive, int *deadline )
+{
+    if (seats[n].dead_since != -1) return;
+    seats[n].dead_since = timestamp;
+    players[n].dead = true;
+    --*alive;
+
+    if (timestamp < WARMUP_TIME) return;
+
+    if (*alive <= 1 && *deadline == -1) *deadline = timestamp + VICTORY_TIME;
+
+    /* Players that die in the same frame get points for each other's death */
+    for (size_t m = 0; m < seats.size(); ++m)
+    {
+        if ( (int)m != n && ( seats[m].dead_since == -1 ||
+                              seats[m].dead_since == timestamp ) )
+        {
+            seats[m].score += 1;
+        }
+    }
+}
+
+/* Plays a single match and merges the results into g_stats. */
+static void play_match(int match, Field *field)
+{
+    const int num_players = g_players;
+    Random rng(g_seed*2654435761u + match);
+
+    GameParameters gp;
+    gp.gameid           = rng.next();
+    gp.data_rate        = FPS;
+    gp.turn_rate        = 2.0*M_PI/TURN_RATE;
+    gp.move_rate        = 1e-3*MOVE_RATE;
+    gp.line_width       = 1e-3*LINE_WIDTH;
+    gp.warmup           = WARMUP_TIME;
+    gp.score_rounds     = 1;
+    gp.hole_probability = HOLE_PROBABILITY;
+    gp.hole_length_min  = HOLE_LENGTH_MIN;
+    gp.hole_length_max  = HOLE_LENGTH_MAX;
+    gp.hole_cooldown    = HOLE_COOLDOWN;
+    gp.move_backlog     = 0;
+    gp.num_players      = num_players;
+
+    std::vector<BotStats> stats(g_bot_names.size());
+    std::vector<Seat> seats(num_players);
+    std::vector<Player> players(num_players);
+    std::vector<Move> moves(num_players);
+
+    /* Seat bots (rotating seats between matches) and reset players */
+    for (int n = 0; n < num_players; ++n)
+    {
+        Seat &seat = seats[n];
+        seat.bot = (match + n)%g_bot_names.size();
+        seat.pc  = PlayerController::load_bot(g_bot_names[seat.bot].c_str());
+        if (seat.pc == NULL)
+        {
+            fatal("could not load bot \"%s\"", g_bot_names[seat.bot].c_str());
+        }
+        seat.has_moved  = false;
+        seat.dead_since = -1;
+        seat.score      = 0;
+        HoleParams params = hole_params(gp);
+        hole_schedule_init(&seat.holes, &params, gp.gameid, n);
+
+        Player &pl = players[n];
+        memset(&pl, 0, sizeof(pl));
+        pl.pos.x = rng.range(2048, 65536 - 2048)/65536.0;
+        pl.pos.y = rng.range(2048, 65536 - 2048)/65536.0;
+        pl.pos.a = rng.range(0, 65535)*(2*M_PI/65536);
+        pl.ppos  = pl.pos;
+        pl.name  = g_bot_names[seat.bot].c_str();
+    }
+    for (int n = 0; n < num_players; ++n) seats[n].pc->restart(gp);
+
+    memset(field, 0, sizeof(Field));
+    int alive = num_players, deadline = -1;
+    const int max_time = WARMUP_TIME + g_max_seconds*FPS;
+    int t;
+    for (t = 0; alive > 0 && (deadline == -1 || t < deadline) && t < max_time; ++t)
+    {
+        /* Ask all living bots for their move, based on the same game state */
+        for (int n = 0; n < num_players; ++n)
+        {
+            if (seats[n].dead_since != -1) continue;
+            double start = time_now();
+            seats[n].pc->field_changed(seats[n].changes);
+            seats[n].changes.clear();
+            Move m = seats[n].pc->move(t, &players[0], n, *field);
+            double latency = time_now() - start;
+            stats[seats[n].bot].moves += 1;
+            stats[seats[n].bot].latency[latency_bucket(latency)] += 1;
+            if (m != MOVE_TURN_LEFT && m != MOVE_TURN_RIGHT) m = MOVE_FORWARD;
+            moves[n] = m;
+        }
+
+        /* Execute moves in player order (like the server does) */
+        for (int n = 0; n < num_players; ++n)
+        {
+            Seat &seat = seats[n];
+            Player &pl = players[n];
+            if (seat.dead_since != -1) continue;
+
+            Move m = moves[n];
+            pl.hole = hole_schedule_hole(&seat.holes, t);
+
+            const double move_rate = t < WARMUP_TIME ? 0 : gp.move_rate;
+            if (move_rate == 0 && m != MOVE_FORWARD) seat.has_moved = true;
+
+            Position npos = pl.pos;
+            position_update(&npos, m, move_rate, gp.turn_rate);
+            FieldChange fc = { n, pl.pos, npos, Rect() };
+            if ( move_rate > 0 &&
+                 field_line_th( field, &pl.pos, &npos,
+                                FIELD_SIZE*gp.line_width,
+                                pl.hole > 0 ? -1 : n + 1, &fc.rect ) != 0 )
+            {
+                kill_player(seats, players, n, t, &alive, &deadline);
+            }
+            if (move_rate > 0 && pl.hole == 0)
+            {
+                for (int k = 0; k < num_players; ++k)
+                {
+                    if (seats[k].dead_since == -1) seats[k].changes.push_back(fc);
+                }
+            }
+
+            for (int k = 0; k < num_players; ++k)
+            {
+                seats[k].pc->watch_player( n, t, m, move_rate, gp.turn_rate,
+                                           pl.hole == 0, pl.pos, npos );
+            }
+
+            pl.pos = pl.ppos = npos;
+            pl.last_move = m;
+            if (t + 1 == WARMUP_TIME && !seat.has_moved)
+            {
+                kill_player(seats, players, n, t, &alive, &deadline);
+            }
+
+            pl.timestamp = pl.pt = t + 1;
+        }
+    }
+
+    /* Determine the winner (the unique player with the highest score) */
+    int winner = 0, best_count = 0;
+    for (int n = 0; n < num_players; ++n)
+    {
+        if (seats[n].score > seats[winner].score) winner = n, best_count = 0;
+        if (seats[n].score == seats[winner].score) ++best_count;
+    }
+    if (best_count > 1) winner = -1;
+
+    for (int n = 0; n < num_players; ++n)
+    {
+        BotStats &bs = stats[seats[n].bot];
+        int end = seats[n].dead_since == -1 ? t : seats[n].dead_since;
+        bs.matches  += 1;
+        bs.wins     += (n == winner);
+        bs.points   += seats[n].score;
+        bs.survival += end > WARMUP_TIME ? end - WARMUP_TIME : 0;
+        delete seats[n].pc;
+    }
+
+    /* Merge results */
+    pthread_mutex_lock(&g_mutex);
+    for (size_t b = 0; b < stats.size(); ++b)
+    {
+        g_stats[b].matches  += stats[b].matches;
+        g_stats[b].wins     += stats[b].wins;
+        g_stats[b].points   += stats[b].points;
+        g_stats[b].survival += stats[b].survival;
+        g_stats[b].moves    += stats[b].moves;
+        for (int i = 0; i < LATENCY_BUCKETS; ++i)
+        {
+            g_stats[b].latency[i] += stats[b].latency[i];
+        }
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+static void *worker(void *arg)
+{
+    (void)arg;
+
+    /* Fields are large, so each worker allocates its own once */
+    Field *field = (Field*)malloc(sizeof(Field));
+    if (field == NULL) fatal("out of memory");
+
+    for (;;)
+    {
+        pthread_mutex_lock(&g_mutex);
+        int match = g_next_match < g_matches ? g_next_match++ : -1;
+        pthread_mutex_unlock(&g_mutex);
+        if (match < 0) break;
+        play_match(match, field);
+    }
+
+    free(field);
+    return NULL;
+}
+
+/* Returns the latency (in microseconds) below which fraction `p' of the
+   recorded move() calls fall. */
+static double latency_percentile(const BotStats &bs, double p)
+{
+    long long count = 0, limit = (long long)ceil(p*bs.moves);
+    for (int b = 0; b < LATENCY_BUCKETS; ++b)
+    {
+        count += bs.latency[b];
+        if (count >= limit && count > 0) return latency_bucket_limit(b);
+    }
+    return 0;
+}
+
+static void print_results()
+{
+    printf( "%-16s %7s %6s %6s %8s %8s %8s %8s %8s\n", "bot", "matches",
+            "win%", "points", "surv(s)", "p50(us)", "p90(us)", "p99(us)",
+            "max(us)" );
+    for (size_t b = 0; b < g_bot_names.size(); ++b)
+    {
+        const BotStats &bs = g_stats[b];
+        if (bs.matches == 0) continue;
+        printf( "%-16s %7d %6.1f %6.2f %8.1f %8.0f %8.0f %8.0f %8.0f\n",
+                g_bot_names[b].c_str(), bs.matches,
+                100.0*bs.wins/bs.matches, (double)bs.points/bs.matches,
+                (double)bs.survival/bs.matches/FPS,
+                latency_percentile(bs, 0.50), latency_percentile(bs, 0.90),
+                latency_percentile(bs, 0.99), latency_percentile(bs, 1.00) );
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] bot1 bot2 [bot3 ...]\n\n"
+        "Plays matches between bots loaded from bots/<name>.so.\n\n"
+        "Options:\n"
+        "  --matches=N      number of matches to play (default: %d)\n"
+        "  --players=N      players per match (default: number of bots)\n"
+        "  --threads=N      worker threads (default: number of CPUs)\n"
+        "  --max-seconds=N  maximum match length in seconds (default: %d)\n"
+        "  --seed=N         random seed (default: %u)\n",
+        prog, g_matches, g_max_seconds, g_seed);
+    exit(EXIT_FAILURE);
+}
+
+static bool parse_int_arg(const char *arg, const char *name, int min, int *value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+    *value = atoi(arg + len + 1);
+    if (*value < min) fatal("%s must be at least %d", name, min);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    time_reset();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        int seed = 0;
+        if (argv[i][0] != '-') g_bot_names.push_back(argv[i]);
+        else if (parse_int_arg(argv[i], "--matches", 1, &g_matches)) continue;
+        else if (parse_int_arg(argv[i], "--players", 1, &g_players)) continue;
+        else if (parse_int_arg(argv[i], "--threads", 1, &g_threads)) continue;
+        else if (parse_int_arg(argv[i], "--max-seconds", 1, &g_max_seconds)) continue;
+        else if (parse_int_arg(argv[i], "--seed", 0, &seed)) g_seed = seed;
+        else usage(argv[0]);
+    }
+    if (g_bot_names.size() < 2) usage(argv[0]);
+    if (g_players == 0) g_players = (int)g_bot_names.size();
+    if (g_players > 255) fatal("too many players per match");
+    if (g_threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        g_threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (g_threads > g_matches) g_threads = g_matches;
+
+    /* Bots that are not thread-safe must run on the main thread */
+    bool threaded = true;
+    for (size_t b = 0; b < g_bot_names.size(); ++b)
+    {
+        const char *name = g_bot_names[b].c_str();
+        PlayerController *pc = PlayerController::load_bot(name);
+        if (pc == NULL) fatal("could not load bot \"%s\"", name);
+        if (!pc->threaded())
+        {
+            info("%s is not thread-safe; playing on the main thread only", name);
+            threaded = false;
+        }
+        delete pc;
+    }
+    if (!threaded) g_threads = 1;
+
+    g_stats.resize(g_bot_names.size());
+
+    info( "playing %d matches with %d players each on %d threads",
+          g_matches, g_players, g_threads );
+
+    double start = time_now();
+    if (!threaded)
+    {
+        worker(NULL);
+    }
+    else
+    {
+        std::vector<pthread_t> threads(g_threads);
+        for (int n = 0; n < g_threads; ++n)
+        {
+            if (pthread_create(&threads[n], NULL, worker, NULL) != 0)
+            {
+                fatal("could not create worker thread");
+            }
+        }
+        for (int n = 0; n < g_threads; ++n) pthread_join(threads[n], NULL);
+    }
+
+    print_results();
+    info("%d matches played in %.3f seconds", g_matches, time_now() - start);
+    return 0;
+}
@@ -12,6 +12,8 @@ public:
     Move move( int timestamp, const Player *players,
                int player_index, const Field &field );
 
+    bool threaded() { return true; }
+
 private:
     int warmup, period;
 };
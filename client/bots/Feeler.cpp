@@ -0,0 +1,62 @@
+#include "SimpleSearch.h"
+#include "RaySensor.h"
+#include <math.h>
+#include <algorithm>
+
+/* A bot that steers towards open space: it casts a fan of rays ahead of it,
+   and prefers turning towards the side where the rays travel furthest.
+   Moves are then tried in that order by SimpleSearch, which picks the first
+   one that survives longest. */
+class Feeler : public SimpleSearch
+{
+public:
+    void restart(const GameParameters &gp)
+    {
+        sensor.clear();
+        SimpleSearch::restart(gp);
+    }
+
+    void field_changed(const std::vector<FieldChange> &changes)
+    {
+        SimpleSearch::field_changed(changes);
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            sensor.invalidate(changes[i].rect);
+        }
+    }
+
+    Move move( int timestamp, const Player *players,
+               int player_index, const Field &field )
+    {
+        if (timestamp >= gp.warmup)
+        {
+            sensor.update(field);
+
+            /* Rays are ordered from right to left; the middle quarter
+               counts towards going forward. */
+            double dist[rays], score[3] = { 0, 0, 0 };
+            sensor.cast_fan( players[player_index].ppos, rays, M_PI,
+                             2*gp.line_width, dist );
+            for (int i = 0; i < rays; ++i)
+            {
+                if (i < rays/2) score[2] += dist[i];
+                if (i >= rays/2) score[0] += dist[i];
+                if (i >= 3*rays/8 && i < 5*rays/8) score[1] += 4*dist[i];
+            }
+
+            std::pair<double, Move> order[3] = {
+                std::make_pair(-score[0], MOVE_TURN_LEFT),
+                std::make_pair(-score[1], MOVE_FORWARD),
+                std::make_pair(-score[2], MOVE_TURN_RIGHT) };
+            std::stable_sort(order, order + 3);
+            for (int i = 0; i < 3; ++i) moves[i] = order[i].second;
+        }
+        return SimpleSearch::move(timestamp, players, player_index, field);
+    }
+
+private:
+    static const int rays = 64;     /* number of rays cast */
+    RaySensor sensor;
+};
+
+extern "C" PlayerController *create_bot() { return new Feeler; }
@@ -36,6 +36,9 @@ public:
         else
             return SimpleSearch::move(timestamp, players, player_index, field);
     }
+
+    /* Reads keys with FLTK, so must run on the main thread */
+    bool threaded() { return false; }
 };
 
 extern "C" PlayerController *create_bot() { return new Hybrid; }
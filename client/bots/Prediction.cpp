@@ -0,0 +1,308 @@
+#include "Prediction.h"
+#include <math.h>
+#include <string.h>
+#include <map>
+
+/* Predictors of the games in progress, by game id */
+static pthread_mutex_t g_predictors_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<unsigned, Predictor*> g_predictors;
+
+/* Prior transition counts: players tend to repeat their last move */
+static const int prior_same  = 4;
+static const int prior_other = 1;
+
+static int move_index(Move move)
+{
+    switch (move)
+    {
+    case MOVE_FORWARD:      return 0;
+    case MOVE_TURN_LEFT:    return 1;
+    case MOVE_TURN_RIGHT:   return 2;
+    default:                return -1;
+    }
+}
+
+Prediction::Prediction()
+{
+    for (int y = 0; y < SIZE; ++y)
+    {
+        for (int x = 0; x < SIZE; ++x)
+        {
+            m_prob[y][x]  = 0;
+            m_first[y][x] = 255;
+        }
+    }
+}
+
+bool Prediction::cell_of(const Position &pos, int *cx, int *cy)
+{
+    if (!(pos.x >= 0 && pos.x < 1 && pos.y >= 0 && pos.y < 1)) return false;
+    *cx = (int)(pos.x*SIZE);
+    *cy = (int)(pos.y*SIZE);
+    return true;
+}
+
+double Prediction::probability(const Position &pos) const
+{
+    int cx, cy;
+    if (!cell_of(pos, &cx, &cy)) return 0;
+    return m_prob[cy][cx];
+}
+
+int Prediction::arrival(const Position &pos) const
+{
+    int cx, cy;
+    if (!cell_of(pos, &cx, &cy) || m_first[cy][cx] == 255) return -1;
+    return m_first[cy][cx];
+}
+
+Predictor::Model::Model()
+    : last_timestamp(-1), last_move(-1), has_holes(false), holes_gameid(0)
+{
+    memset(counts, 0, sizeof(counts));
+}
+
+Predictor::Predictor()
+    : m_game(0), m_users(0), m_gameid(0), m_timestamp(-1), m_stamp(0)
+{
+    pthread_mutex_init(&m_mutex, NULL);
+}
+
+Predictor::~Predictor()
+{
+    pthread_mutex_destroy(&m_mutex);
+}
+
+Predictor *Predictor::acquire(unsigned gameid)
+{
+    pthread_mutex_lock(&g_predictors_mutex);
+    Predictor *&predictor = g_predictors[gameid];
+    if (predictor == NULL)
+    {
+        predictor = new Predictor;
+        predictor->m_game = gameid;
+    }
+    ++predictor->m_users;
+    pthread_mutex_unlock(&g_predictors_mutex);
+    return predictor;
+}
+
+void Predictor::release(Predictor *predictor)
+{
+    if (predictor == NULL) return;
+
+    pthread_mutex_lock(&g_predictors_mutex);
+    if (--predictor->m_users == 0)
+    {
+        g_predictors.erase(predictor->m_game);
+        delete predictor;
+    }
+    pthread_mutex_unlock(&g_predictors_mutex);
+}
+
+void Predictor::watch( int player_index, int timestamp, Move move,
+                       double move_rate )
+{
+    if (player_index < 0) return;
+
+    pthread_mutex_lock(&m_mutex);
+    if ((int)m_models.size() <= player_index)
+    {
+        m_models.resize(player_index + 1);
+    }
+
+    Model &model = m_models[player_index];
+    if (timestamp < model.last_timestamp)
+    {
+        /* A new game started; forget the previous player's moves */
+        model = Model();
+    }
+    if (timestamp != model.last_timestamp)
+    {
+        int m = move_index(move);
+        if ( move_rate > 0 && m >= 0 && model.last_move >= 0 &&
+             timestamp == model.last_timestamp + 1 )
+        {
+            ++model.counts[model.last_move][m];
+        }
+        model.last_timestamp = timestamp;
+        model.last_move      = m;
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+bool Predictor::cached( int timestamp, const Player *players,
+                        const GameParameters &gp )
+{
+    bool res = gp.gameid == m_gameid && timestamp == m_timestamp &&
+               (int)m_player_timestamps.size() == gp.num_players;
+    for (int n = 0; res && n < gp.num_players; ++n)
+    {
+        int t = players[n].dead ? -1 : players[n].timestamp;
+        res = m_player_timestamps[n] == t;
+    }
+    if (!res)
+    {
+        m_gameid    = gp.gameid;
+        m_timestamp = timestamp;
+        m_player_timestamps.resize(gp.num_players);
+        for (int n = 0; n < gp.num_players; ++n)
+        {
+            m_player_timestamps[n] = players[n].dead ? -1
+                                                     : players[n].timestamp;
+        }
+    }
+    return res;
+}
+
+void Predictor::simulate( int timestamp, const Player &pl,
+                          const GameParameters &gp, Model &model,
+                          int player_index )
+{
+    const int size = Prediction::SIZE;
+    model.hits.assign(size*size, 0);
+    model.first.assign(size*size, 255);
+
+    int frames = timestamp + Prediction::HORIZON - pl.timestamp;
+    if (pl.dead || frames <= 0) return;
+
+    /* Holes do not depend on the moves made, so they are looked up in the
+       player's hole schedule. */
+    if (!model.has_holes || model.holes_gameid != gp.gameid)
+    {
+        HoleParams params = hole_params(gp);
+        hole_schedule_init(&model.holes, &params, gp.gameid, player_index);
+        model.has_holes    = true;
+        model.holes_gameid = gp.gameid;
+    }
+    std::vector<char> solid(frames);
+    for (int i = 0; i < frames; ++i) solid[i] = pl.timestamp + i >= gp.warmup;
+
+    /* Clear the rest of the current hole (if any), then each hole that
+       starts within the frames predicted. */
+    int t = pl.timestamp, length = hole_schedule_hole(&model.holes, t);
+    while (t >= 0)
+    {
+        for (int i = t - pl.timestamp; i < t + length - pl.timestamp; ++i)
+        {
+            if (i < frames) solid[i] = false;
+        }
+        t = hole_schedule_next( &model.holes, t + length, pl.timestamp + frames,
+                                &length );
+    }
+
+    /* Cumulative transition weights, and movement per move */
+    int weights[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        int sum = 0;
+        for (int j = 0; j < 3; ++j)
+        {
+            sum += model.counts[i][j] + (i == j ? prior_same : prior_other);
+            weights[i][j] = sum;
+        }
+    }
+    double chord_cos[3], chord_sin[3], chord_len[3], turn_cos[3], turn_sin[3];
+    for (int m = 0; m < 3; ++m)
+    {
+        double da = m == 0 ? 0 : m == 1 ? gp.turn_rate : -gp.turn_rate;
+        chord_cos[m] = cos(da/2);
+        chord_sin[m] = sin(da/2);
+        chord_len[m] = gp.move_rate*(da ? sin(da/2)/(da/2) : 1);
+        turn_cos[m]  = cos(da);
+        turn_sin[m]  = sin(da);
+    }
+
+    /* Sample paths; the random seed depends only on the game state, so all
+       bots get the same prediction. */
+    unsigned long long rng = 0x9e3779b97f4a7c15ull*(gp.gameid + 1) +
+                             0xbf58476d1ce4e5b9ull*(timestamp + 1) +
+                             0x94d049bb133111ebull*(player_index + 1);
+    m_seen.resize(size*size);
+    for (int s = 0; s < Prediction::SAMPLES; ++s)
+    {
+        if (++m_stamp == 0)
+        {
+            m_seen.assign(size*size, 0);
+            m_stamp = 1;
+        }
+
+        double x = pl.pos.x, y = pl.pos.y;
+        double dx = cos(pl.pos.a), dy = sin(pl.pos.a);
+        int last = move_index((Move)pl.last_move);
+        if (last < 0) last = 0;
+        for (int i = 0; i < frames; ++i)
+        {
+            rng = rng*6364136223846793005ull + 1442695040888963407ull;
+            int r = (int)((rng >> 33)%weights[last][2]), m = 0;
+            while (r >= weights[last][m]) ++m;
+            last = m;
+
+            double cx = dx*chord_cos[m] - dy*chord_sin[m];
+            double cy = dx*chord_sin[m] + dy*chord_cos[m];
+            double ndx = dx*turn_cos[m] - dy*turn_sin[m];
+            dy = dx*turn_sin[m] + dy*turn_cos[m];
+            dx = ndx;
+            if (pl.timestamp + i < gp.warmup) continue;
+            x += chord_len[m]*cx;
+            y += chord_len[m]*cy;
+            if (!(x >= 0 && x < 1 && y >= 0 && y < 1)) break;
+            if (!solid[i]) continue;
+
+            int cell = (int)(y*size)*size + (int)(x*size);
+            int frame = pl.timestamp + i - timestamp;
+            if (frame < 0) frame = 0;
+            if (frame < model.first[cell]) model.first[cell] = frame;
+            if (m_seen[cell] != m_stamp)
+            {
+                m_seen[cell] = m_stamp;
+                ++model.hits[cell];
+            }
+        }
+    }
+}
+
+void Predictor::predict( int timestamp, const Player *players,
+                         int player_index, const GameParameters &gp,
+                         Prediction *out )
+{
+    const int size = Prediction::SIZE;
+
+    pthread_mutex_lock(&m_mutex);
+    if (!cached(timestamp, players, gp))
+    {
+        if ((int)m_models.size() < gp.num_players)
+        {
+            m_models.resize(gp.num_players);
+        }
+        for (int n = 0; n < gp.num_players; ++n)
+        {
+            simulate(timestamp, players[n], gp, m_models[n], n);
+        }
+    }
+
+    /* Combine the other players' predictions, assuming independence */
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            double free = 1;
+            int first = 255;
+            for (int n = 0; n < gp.num_players; ++n)
+            {
+                if (n == player_index) continue;
+                const Model &model = m_models[n];
+                int hits = model.hits[y*size + x];
+                if (hits == 0) continue;
+                free *= 1.0 - (double)hits/Prediction::SAMPLES;
+                if (model.first[y*size + x] < first)
+                {
+                    first = model.first[y*size + x];
+                }
+            }
+            out->m_prob[y][x]  = (float)(1 - free);
+            out->m_first[y][x] = (unsigned char)first;
+        }
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
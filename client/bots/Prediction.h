@@ -0,0 +1,118 @@
+#ifndef PREDICTION_H_INCLUDED
+#define PREDICTION_H_INCLUDED
+
+#include <client/PlayerController.h>
+#include <pthread.h>
+#include <vector>
+
+/* Predicted occupancy of the field by other players over the next HORIZON
+   frames, on a grid of CELL x CELL pixel cells (see Predictor below). */
+class Prediction
+{
+public:
+    enum {
+        CELL    = 16,               /* pixels per cell (in each direction) */
+        SIZE    = FIELD_SIZE/CELL,  /* cells per row/column */
+        HORIZON = 60,               /* frames predicted */
+        SAMPLES = 32                /* simulated paths per player */
+    };
+
+    Prediction();
+
+    /* Returns the estimated probability that another player draws a line
+       through the cell containing `pos' within the next HORIZON frames. */
+    double probability(const Position &pos) const;
+
+    /* Returns the lowest number of frames from now after which another
+       player might draw a line through the cell containing `pos', or -1 if
+       no other player is expected to. */
+    int arrival(const Position &pos) const;
+
+private:
+    friend class Predictor;
+
+    static bool cell_of(const Position &pos, int *cx, int *cy);
+
+    float m_prob[SIZE][SIZE];           /* probability of being occupied */
+    unsigned char m_first[SIZE][SIZE];  /* earliest frame (or 255 if none) */
+};
+
+/* Predicts where players will draw lines in the near future.
+
+   Each player's moves are modelled as a Markov chain: the probability of
+   each move depends on the player's previous move, estimated from the moves
+   watched so far this game. Paths are sampled from this model, while holes
+   are predicted exactly, using the player's hole schedule.
+
+   The sampled paths of all players are cached per frame, so bots sharing the
+   predictor of a game (through acquire()) simulate each player only once per
+   frame. Games played at the same time (e.g. in a tournament) use different
+   predictors, so they do not affect each other. */
+class Predictor
+{
+public:
+    Predictor();
+    ~Predictor();
+
+    /* Returns the predictor shared by all bots in this process that play the
+       game with the given id, creating it if necessary. Each call must be
+       paired with a call to release() when the bot is done with the game. */
+    static Predictor *acquire(unsigned gameid);
+
+    /* Releases a predictor returned by acquire(); the predictor is deleted
+       when no bots use it anymore. */
+    static void release(Predictor *predictor);
+
+    /* Records a player's move; should be called from watch_player(). Moves
+       reported more than once (e.g. by different bots) are counted once. */
+    void watch( int player_index, int timestamp, Move move,
+                double move_rate );
+
+    /* Stores in `out' the predicted occupancy of the field by all players
+       other than `player_index', starting at the given timestamp. */
+    void predict( int timestamp, const Player *players, int player_index,
+                  const GameParameters &gp, Prediction *out );
+
+private:
+    /* Per-player state */
+    struct Model
+    {
+        Model();
+
+        int last_timestamp;         /* last move recorded */
+        int last_move;              /* index of last move recorded */
+        int counts[3][3];           /* move transitions observed */
+        std::vector<unsigned char> hits;    /* samples per cell */
+        std::vector<unsigned char> first;   /* earliest frame per cell */
+        bool has_holes;             /* is the hole schedule initialized? */
+        unsigned holes_gameid;      /* game the hole schedule is for */
+        HoleSchedule holes;         /* when the player makes holes */
+    };
+
+    bool cached( int timestamp, const Player *players,
+                 const GameParameters &gp );
+    void simulate( int timestamp, const Player &pl, const GameParameters &gp,
+                   Model &model, int player_index );
+
+    Predictor(const Predictor &);
+    Predictor &operator=(const Predictor &);
+
+private:
+    pthread_mutex_t m_mutex;
+    std::vector<Model> m_models;
+
+    /* Game shared by the users of this predictor (see acquire()) */
+    unsigned m_game;
+    int m_users;
+
+    /* Key of the cached prediction */
+    unsigned m_gameid;
+    int m_timestamp;
+    std::vector<int> m_player_timestamps;
+
+    /* Marks cells visited by the current sample */
+    std::vector<unsigned> m_seen;
+    unsigned m_stamp;
+};
+
+#endif /* ndef PREDICTION_H_INCLUDED */
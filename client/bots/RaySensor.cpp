@@ -0,0 +1,131 @@
+#include "RaySensor.h"
+#include <math.h>
+
+RaySensor::RaySensor()
+    : m_field(NULL)
+{
+    clear();
+}
+
+void RaySensor::clear()
+{
+    occupancy_clear(&m_occ);
+    m_all = false;
+    m_dirty.clear();
+}
+
+void RaySensor::invalidate(const Position &p, const Position &q, double line_width)
+{
+    Rect rect;
+    field_line_rect(&p, &q, FIELD_SIZE*line_width, &rect);
+    invalidate(rect);
+}
+
+void RaySensor::invalidate(const Rect &rect)
+{
+    if (!m_all) m_dirty.push_back(rect);
+}
+
+void RaySensor::invalidate_all()
+{
+    m_all = true;
+    m_dirty.clear();
+}
+
+void RaySensor::update(const Field &field)
+{
+    m_field = &field;
+    if (m_all)
+    {
+        occupancy_rebuild(&m_occ, &field);
+        m_all = false;
+    }
+    for (size_t n = 0; n < m_dirty.size(); ++n)
+    {
+        occupancy_update(&m_occ, &field, &m_dirty[n]);
+    }
+    m_dirty.clear();
+}
+
+/* Traces a ray from pixel coordinates (x, y) in direction (dx, dy) (a unit
+   vector), starting `t' pixels from the origin, and returns the distance
+   (in pixels) at which it hits an occupied pixel or leaves the field. */
+double RaySensor::trace( double x, double y, double dx, double dy,
+                         double t ) const
+{
+    /* Small step to move from one block into the next */
+    const double eps = 1e-6;
+
+    for (;;)
+    {
+        double cx = x + t*dx, cy = y + t*dy;
+        if (!(cx >= 0 && cy >= 0 && cx < FIELD_SIZE && cy < FIELD_SIZE))
+        {
+            return t;
+        }
+
+        /* Find the largest empty block containing the current point */
+        int px = (int)cx, py = (int)cy, size;
+        if (!m_occ.l128[py/128][px/128])
+        {
+            size = 128;
+        }
+        else
+        if (!m_occ.l32[py/32][px/32])
+        {
+            size = 32;
+        }
+        else
+        if (!m_occ.l8[py/8][px/8])
+        {
+            size = 8;
+        }
+        else
+        {
+            if (m_field == NULL || (*m_field)[py][px] != 0) return t;
+            size = 1;
+        }
+
+        /* Advance to the point where the ray leaves the block (blocks at
+           the edges may extend past the field, which ends the ray) */
+        int bx1 = px - px%size, bx2 = bx1 + size;
+        int by1 = py - py%size, by2 = by1 + size;
+        if (bx2 > FIELD_SIZE) bx2 = FIELD_SIZE;
+        if (by2 > FIELD_SIZE) by2 = FIELD_SIZE;
+        double tx, ty;
+        if (dx > 0) tx = (bx2 - x)/dx;
+        else if (dx < 0) tx = (bx1 - x)/dx;
+        else tx = HUGE_VAL;
+        if (dy > 0) ty = (by2 - y)/dy;
+        else if (dy < 0) ty = (by1 - y)/dy;
+        else ty = HUGE_VAL;
+        double exit = tx < ty ? tx : ty;
+        t = (exit > t ? exit : t) + eps;
+    }
+}
+
+double RaySensor::cast(const Position &pos, double a, double skip) const
+{
+    double t = trace( FIELD_SIZE*pos.x, FIELD_SIZE*pos.y,
+                      cos(a), sin(a), FIELD_SIZE*skip );
+    return t/FIELD_SIZE;
+}
+
+void RaySensor::cast_fan( const Position &pos, int count, double spread,
+                          double skip, double *dist ) const
+{
+    if (count <= 0) return;
+
+    /* Rotate the direction incrementally from ray to ray, instead of
+       calculating the sine and cosine of each angle. */
+    double step = spread/count, a = pos.a - 0.5*spread + 0.5*step;
+    double dx = cos(a), dy = sin(a), rc = cos(step), rs = sin(step);
+    double x = FIELD_SIZE*pos.x, y = FIELD_SIZE*pos.y, t = FIELD_SIZE*skip;
+    for (int i = 0; i < count; ++i)
+    {
+        dist[i] = trace(x, y, dx, dy, t)/FIELD_SIZE;
+        double ndx = dx*rc - dy*rs;
+        dy = dx*rs + dy*rc;
+        dx = ndx;
+    }
+}
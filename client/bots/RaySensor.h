@@ -0,0 +1,60 @@
+#ifndef RAY_SENSOR_H_INCLUDED
+#define RAY_SENSOR_H_INCLUDED
+
+#include <client/PlayerController.h>
+#include <common/Occupancy.h>
+#include <vector>
+
+/* Measures free distances on the field for bots, by casting rays.
+
+   Keeps an occupancy pyramid of the field (see common/Occupancy.h), which
+   is updated incrementally like SpaceEval's grid: bots report the line
+   segments drawn (e.g. from watch_player()) and the affected blocks are
+   re-read from the field on the next call to update().
+
+   Rays skip over empty blocks of the pyramid in a single step, and only
+   visit individual pixels inside occupied 8x8 blocks, so a ray crossing an
+   empty field takes a few dozen steps instead of thousands. */
+class RaySensor
+{
+public:
+    RaySensor();
+
+    /* Marks the whole field as empty. */
+    void clear();
+
+    /* Marks the pixels covered by a segment (drawn `line_width' wide) or by
+       a rectangle of pixels as changed. */
+    void invalidate(const Position &p, const Position &q, double line_width);
+    void invalidate(const Rect &rect);
+
+    /* Marks the whole field as changed. */
+    void invalidate_all();
+
+    /* Re-reads changed blocks from the field. */
+    void update(const Field &field);
+
+    /* Returns the distance (in field units) that a ray starting at `pos' in
+       direction `a' travels before hitting an occupied pixel or the edge of
+       the field. The first `skip' units of the ray are not tested; this
+       should be at least the line width, to skip the player's own head. */
+    double cast(const Position &pos, double a, double skip) const;
+
+    /* Casts a fan of `count' rays from `pos', evenly spread over an angle
+       of `spread' radians centered on the heading pos.a (in order of
+       increasing angle), and stores their distances in `dist'. A spread of
+       2*M_PI casts rays in all directions. */
+    void cast_fan( const Position &pos, int count, double spread,
+                   double skip, double *dist ) const;
+
+private:
+    double trace( double x, double y, double dx, double dy,
+                  double t ) const;
+
+    const Field *m_field;       /* field last passed to update() */
+    Occupancy m_occ;            /* occupied blocks of m_field */
+    bool m_all;                 /* all blocks must be re-read? */
+    std::vector<Rect> m_dirty;  /* rectangles to be re-read */
+};
+
+#endif /* ndef RAY_SENSOR_H_INCLUDED */
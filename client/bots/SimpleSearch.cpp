@@ -1,9 +1,20 @@
 #include "SimpleSearch.h"
+#include <common/Time.h>
 #include <math.h>
 
-static const int max_depth = 7;
+/* Search depth is increased from min_depth until the budget runs out,
+   up to max_depth. Level d of the search tree covers 2 + 2*d moves. */
+static const int min_depth = 3;
+static const int max_depth = 14;
+static const double time_budget = 0.005;    /* default budget per move */
+
+/* Transposition table size (must be a power of two) */
+static const int table_bits = 17;
 
 SimpleSearch::SimpleSearch()
+    : field(NULL), budget(time_budget), occupancy_valid(false),
+      table(1 << table_bits), stamp(0), horizon(0),
+      deadline(0), aborted(false), nodes(0)
 {
     moves[0] = MOVE_FORWARD;
     moves[1] = MOVE_TURN_LEFT;
@@ -13,39 +24,161 @@ SimpleSearch::SimpleSearch()
 void SimpleSearch::restart(const GameParameters &gp_arg)
 {
     gp = gp_arg;
+    occupancy_valid = false;
+    dirty.clear();
 }
 
-int SimpleSearch::search(Position pos, int depth, Move *move_out)
+void SimpleSearch::field_changed(const std::vector<FieldChange> &changes)
 {
-    if (depth == max_depth) return max_depth;
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        dirty.push_back(changes[i].rect);
+    }
+}
 
-    Move best_move = MOVE_FORWARD;
-    int best_depth = depth;
+/* Positions are quantized to cells of half the line width, so paths that
+   end up in nearly the same place (with the same heading) share results. */
+unsigned long long SimpleSearch::position_key( const Position &pos,
+                                               int depth, int step )
+{
+    double cell = 0.5*gp.line_width;
+    unsigned long long qx = (unsigned)(int)floor(pos.x/cell) & 0xffff;
+    unsigned long long qy = (unsigned)(int)floor(pos.y/cell) & 0xffff;
+    unsigned long long qa = (unsigned)step & 0xffffff;
+    return (qx << 48) | (qy << 32) | (qa << 8) | (unsigned)depth;
+}
+
+SimpleSearch::Entry *SimpleSearch::probe(unsigned long long key)
+{
+    return &table[(key*0x9e3779b97f4a7c15ull) >> (64 - table_bits)];
+}
+
+/* Returns the deepest level (up to `horizon') reachable from `pos' at level
+   `depth'. `step' is the heading relative to the root, in turn steps.
+
+   Results are stored in the transposition table, including moves that
+   collide immediately (with value 0). A value below the horizon means every
+   path dies before the horizon, which remains true in deeper iterations, so
+   such dead branches are never searched again. Moves that are known to be
+   collision-free are not rasterized again either, so each iteration of
+   the deepening search only pays for the levels it adds. */
+int SimpleSearch::search(const Position &pos, int depth, int step, Move *move_out)
+{
+    if (depth == horizon) return horizon;
+
+    /* The first iteration is always completed, so there is a move to play */
+    ++nodes;
+    if (horizon > min_depth && (nodes & 63) == 0 && time_now() > deadline)
+    {
+        aborted = true;
+    }
+    if (aborted) return depth;
+
+    /* Try the best move of the previous iteration first (but not at the root,
+       where the preferred order of moves must be kept to choose between
+       equally good moves) */
+    unsigned long long key = position_key(pos, depth, step);
+    Entry *entry = probe(key);
+    int first = 0;
+    if (move_out == NULL && entry->stamp == stamp && entry->key == key)
+    {
+        first = entry->best;
+    }
 
-    for (int i = 0; i < 3 && best_depth < max_depth; ++i)
+    int best_index = first;
+    int best_depth = depth;
+    for (int j = 0; j < 3 && best_depth < horizon; ++j)
     {
-        int col = 0;
-        Position old_pos, new_pos = pos;
-        for (int pass = 0; pass < 2 + 2*depth && col == 0; ++pass)
+        int i = (first + j)%3;
+        /* Follow the arc by rotating the direction vector, which is much
+           cheaper than calling position_update() for every pass. */
+        int passes = 2 + 2*depth, new_step = step + passes*turn_steps[i];
+        Position path[2 + 2*max_depth + 1];
+        double da = turn_steps[i]*gp.turn_rate;
+        double dx = cos(pos.a + 0.5*da), dy = sin(pos.a + 0.5*da);
+        double x1 = pos.x, y1 = pos.y, x2 = pos.x, y2 = pos.y;
+        path[0] = pos;
+        for (int pass = 0; pass < passes; ++pass)
         {
-            old_pos = new_pos;
-            position_update(&new_pos, moves[i], gp.move_rate, gp.turn_rate);
-            col += field_line_th( (Field*)field, &old_pos, &new_pos,
-                                  FIELD_SIZE*gp.line_width, -1, NULL );
+            path[pass + 1].x = path[pass].x + step_length[i]*dx;
+            path[pass + 1].y = path[pass].y + step_length[i]*dy;
+            path[pass + 1].a = path[pass].a + da;
+            if (path[pass + 1].x < x1) x1 = path[pass + 1].x;
+            if (path[pass + 1].x > x2) x2 = path[pass + 1].x;
+            if (path[pass + 1].y < y1) y1 = path[pass + 1].y;
+            if (path[pass + 1].y > y2) y2 = path[pass + 1].y;
+            double ndx = dx*turn_cos[i] - dy*turn_sin[i];
+            dy = dx*turn_sin[i] + dy*turn_cos[i];
+            dx = ndx;
         }
+        const Position &new_pos = path[passes];
 
-        if (col == 0)
+        int new_depth;
+        unsigned long long child_key = position_key(new_pos, depth + 1, new_step);
+        Entry *child = probe(child_key);
+        bool known = child->stamp == stamp && child->key == child_key;
+        if ( known && ( child->value < child->horizon ||
+                        child->horizon >= horizon ) )
+        {
+            new_depth = child->value < horizon ? child->value : horizon;
+        }
+        else
         {
-            int new_depth = search(new_pos, depth + 1, NULL);
-            if (new_depth > best_depth)
+            /* Paths leaving the field are dead; no need to rasterize them */
+            int col = 0;
+            if (!known && ( new_pos.x < 0 || new_pos.x >= 1 ||
+                            new_pos.y < 0 || new_pos.y >= 1 )) col = 256;
+            if (col == 0 && !known)
+            {
+                /* Test the whole arc against the occupancy pyramid first;
+                   only if it comes near a wall, test individual segments. */
+                double th = FIELD_SIZE*gp.line_width, r = 0.5*th + 1;
+                Rect rect = { (int)floor(FIELD_SIZE*x1 - r),
+                              (int)floor(FIELD_SIZE*y1 - r),
+                              (int)floor(FIELD_SIZE*x2 + r) + 2,
+                              (int)floor(FIELD_SIZE*y2 + r) + 2 };
+                if (!occupancy_empty(&occupancy, NULL, &rect))
+                {
+                    for (int pass = 0; pass < passes && col == 0; ++pass)
+                    {
+                        col += occupancy_line_test( &occupancy, field,
+                            &path[pass], &path[pass + 1], th );
+                    }
+                }
+            }
+            if (col == 0)
             {
-                best_move = moves[i];
-                best_depth = new_depth;
+                new_depth = search(new_pos, depth + 1, new_step, NULL);
             }
+            else
+            {
+                new_depth       = 0;
+                child->key      = child_key;
+                child->stamp    = stamp;
+                child->value    = 0;
+                child->horizon  = max_depth;
+                child->best     = 0;
+            }
+        }
+
+        if (new_depth > best_depth)
+        {
+            best_index = i;
+            best_depth = new_depth;
         }
     }
 
-    if (move_out != NULL) *move_out = best_move;
+    if (!aborted)
+    {
+        entry->key     = key;
+        entry->stamp   = stamp;
+        entry->value   = best_depth;
+        entry->horizon = horizon;
+        entry->best    = best_index;
+    }
+
+    if (move_out != NULL) *move_out = best_depth > depth ? moves[best_index]
+                                                         : MOVE_FORWARD;
     return best_depth;
 }
 
@@ -56,6 +189,21 @@ Move SimpleSearch::move( int timestamp, const Player *players,
 
     field = &field_arg;
 
+    /* Bring the occupancy pyramid up to date */
+    if (!occupancy_valid)
+    {
+        occupancy_rebuild(&occupancy, field);
+        occupancy_valid = true;
+    }
+    else
+    {
+        for (size_t i = 0; i < dirty.size(); ++i)
+        {
+            occupancy_update(&occupancy, field, &dirty[i]);
+        }
+    }
+    dirty.clear();
+
     /* Join game (even if we start out in the right direction) */
     if (timestamp == 0) return MOVE_TURN_LEFT;
 
@@ -72,9 +220,37 @@ Move SimpleSearch::move( int timestamp, const Player *players,
     }
     else
     {
-        /* Search for path that doesn't kill me soon */
-        Move best_move;
-        search(pos, 0, &best_move);
+        /* Search for path that doesn't kill me soon, deepening the search
+           while time permits. Entries from earlier moves are invalidated,
+           since the field has changed since. */
+        for (int i = 0; i < 3; ++i)
+        {
+            turn_steps[i] = 0;
+            if (moves[i] == MOVE_TURN_LEFT)  turn_steps[i] = +1;
+            if (moves[i] == MOVE_TURN_RIGHT) turn_steps[i] = -1;
+            double da = turn_steps[i]*gp.turn_rate;
+            step_length[i] = gp.move_rate*(da ? sin(da/2)/(da/2) : 1);
+            turn_cos[i] = cos(da);
+            turn_sin[i] = sin(da);
+        }
+
+        ++stamp;
+        nodes    = 0;
+        aborted  = false;
+        deadline = time_now() + budget;
+
+        Move best_move = MOVE_FORWARD;
+        for (horizon = min_depth; horizon <= max_depth; ++horizon)
+        {
+            Move m;
+            int depth = search(pos, 0, 0, &m);
+            if (aborted) break;
+            best_move = m;
+
+            /* If every path dies before the horizon, looking deeper won't
+               change the outcome. */
+            if (depth < horizon) break;
+        }
         return best_move;
     }
 }
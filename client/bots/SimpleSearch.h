@@ -2,6 +2,8 @@
 #define SEMI_RANDOM_H_INCLUDED
 
 #include <client/PlayerController.h>
+#include <common/Occupancy.h>
+#include <vector>
 
 class SimpleSearch : public PlayerController
 {
@@ -13,13 +15,50 @@ public:
     Move move( int timestamp, const Player *players,
                int player_index, const Field &field );
 
+    /* Subclasses that override this must call it, too. */
+    void field_changed(const std::vector<FieldChange> &changes);
+
+    bool threaded() { return true; }
+
 protected:
-    int search(Position pos, int depth, Move *move_out);
+    /* Transposition table entry */
+    struct Entry
+    {
+        unsigned long long key;     /* quantized position/heading/depth */
+        unsigned stamp;             /* search in which entry was stored */
+        unsigned char value;        /* deepest level reached */
+        unsigned char horizon;      /* search horizon when stored */
+        unsigned char best;         /* index of best move */
+    };
+
+    int search(const Position &pos, int depth, int step, Move *move_out);
+    unsigned long long position_key(const Position &pos, int depth, int step);
+    Entry *probe(unsigned long long key);
 
 protected:
     const Field *field;
     GameParameters gp;
     Move moves[3];
+    double budget;              /* search time per move (in seconds) */
+
+    /* Occupancy of the field, updated from segments drawn */
+    Occupancy occupancy;
+    bool occupancy_valid;       /* must be rebuilt if false */
+    std::vector<Rect> dirty;    /* rectangles drawn since last move */
+
+    /* Iterative deepening state */
+    std::vector<Entry> table;   /* transposition table */
+    unsigned stamp;             /* incremented for each move searched */
+    int horizon;                /* depth of current iteration */
+    double deadline;            /* time at which to abort the search */
+    bool aborted;               /* current iteration ran out of time? */
+    long nodes;                 /* nodes visited during current move */
+
+    /* Per-pass movement for each of moves[] */
+    int turn_steps[3];          /* heading change in turn steps */
+    double step_length[3];      /* length of chord */
+    double turn_cos[3];         /* cosine of heading change */
+    double turn_sin[3];         /* sine of heading change */
 };
 
 #endif /* ndef SEMI_RANDOM_H_INCLUDED */
@@ -0,0 +1,231 @@
+#include "SpaceEval.h"
+#include <string.h>
+
+/* Mask of valid cells in the last word of each row */
+static const SpaceEval::Word last_mask =
+    SpaceEval::SIZE%64 ? (1ull << SpaceEval::SIZE%64) - 1 : ~0ull;
+
+SpaceEval::SpaceEval()
+{
+    clear();
+}
+
+void SpaceEval::clear()
+{
+    for (int y = 0; y < SIZE; ++y)
+    {
+        for (int w = 0; w < WORDS; ++w) m_free[y][w] = ~0ull;
+        m_free[y][WORDS - 1] = last_mask;
+    }
+    memset(m_dirty, 0, sizeof(m_dirty));
+    m_dirty_y1 = SIZE;
+    m_dirty_y2 = -1;
+}
+
+void SpaceEval::invalidate(const Position &p, const Position &q, double line_width)
+{
+    double th = 0.5*FIELD_SIZE*line_width + 1;
+    Rect rect;
+    rect.x1 = (int)(FIELD_SIZE*(p.x < q.x ? p.x : q.x) - th);
+    rect.y1 = (int)(FIELD_SIZE*(p.y < q.y ? p.y : q.y) - th);
+    rect.x2 = (int)(FIELD_SIZE*(p.x > q.x ? p.x : q.x) + th) + 1;
+    rect.y2 = (int)(FIELD_SIZE*(p.y > q.y ? p.y : q.y) + th) + 1;
+    invalidate(rect);
+}
+
+void SpaceEval::invalidate(const Rect &rect)
+{
+    int x1 = rect.x1 < 0 ? 0 : rect.x1/CELL;
+    int y1 = rect.y1 < 0 ? 0 : rect.y1/CELL;
+    int x2 = rect.x2 > FIELD_SIZE ? SIZE : (rect.x2 + CELL - 1)/CELL;
+    int y2 = rect.y2 > FIELD_SIZE ? SIZE : (rect.y2 + CELL - 1)/CELL;
+    if (x1 >= x2 || y1 >= y2) return;
+
+    for (int y = y1; y < y2; ++y)
+    {
+        for (int x = x1; x < x2; ++x) m_dirty[y][x/64] |= 1ull << x%64;
+    }
+    if (y1 < m_dirty_y1) m_dirty_y1 = y1;
+    if (y2 - 1 > m_dirty_y2) m_dirty_y2 = y2 - 1;
+}
+
+void SpaceEval::invalidate_all()
+{
+    Rect rect = { 0, 0, FIELD_SIZE, FIELD_SIZE };
+    invalidate(rect);
+}
+
+void SpaceEval::update(const Field &field)
+{
+    for (int y = m_dirty_y1; y <= m_dirty_y2; ++y)
+    {
+        for (int w = 0; w < WORDS; ++w)
+        {
+            for (Word bits = m_dirty[y][w]; bits != 0; bits &= bits - 1)
+            {
+                int x = 64*w + __builtin_ctzll(bits);
+
+                /* Test 8 pixels at a time */
+                Word any = 0;
+                for (int i = 0; i < CELL; ++i)
+                {
+                    for (int j = 0; j < CELL; j += 8)
+                    {
+                        Word pixels;
+                        memcpy( &pixels, &field[CELL*y + i][CELL*x + j],
+                                sizeof(pixels) );
+                        any |= pixels;
+                    }
+                }
+                if (any != 0)
+                {
+                    m_free[y][w] &= ~(1ull << x%64);
+                }
+                else
+                {
+                    m_free[y][w] |= 1ull << x%64;
+                }
+            }
+            m_dirty[y][w] = 0;
+        }
+    }
+    m_dirty_y1 = SIZE;
+    m_dirty_y2 = -1;
+}
+
+bool SpaceEval::cell_of(const Position &pos, int *cx, int *cy)
+{
+    if (!(pos.x >= 0 && pos.x < 1 && pos.y >= 0 && pos.y < 1)) return false;
+    *cx = (int)(FIELD_SIZE*pos.x)/CELL;
+    *cy = (int)(FIELD_SIZE*pos.y)/CELL;
+    return true;
+}
+
+bool SpaceEval::is_free(const Position &pos) const
+{
+    int cx, cy;
+    return cell_of(pos, &cx, &cy) && (m_free[cy][cx/64] >> cx%64 & 1);
+}
+
+/* Stores in rows [y1:y2] of `dst' the cells of `src' and their neighbours
+   (horizontally and vertically). */
+void SpaceEval::dilate(const Row *src, Row *dst, int y1, int y2)
+{
+    for (int y = y1; y <= y2; ++y)
+    {
+        for (int w = 0; w < WORDS; ++w)
+        {
+            Word c = src[y][w];
+            Word d = c | (c << 1) | (c >> 1);
+            if (w > 0)         d |= src[y][w - 1] >> 63;
+            if (w + 1 < WORDS) d |= src[y][w + 1] << 63;
+            if (y > 0)         d |= src[y - 1][w];
+            if (y + 1 < SIZE)  d |= src[y + 1][w];
+            dst[y][w] = d;
+        }
+    }
+}
+
+int SpaceEval::reachable(const Position &pos)
+{
+    int cx, cy;
+    if (!cell_of(pos, &cx, &cy)) return 0;
+
+    memset(m_reach, 0, sizeof(m_reach));
+    m_reach[cy][cx/64] = 1ull << cx%64;
+
+    /* Grow the reached region until it stops changing; only rows next to
+       the region can change. */
+    int y1 = cy, y2 = cy;
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+        int a = y1 > 0 ? y1 - 1 : 0, b = y2 + 1 < SIZE ? y2 + 1 : SIZE - 1;
+        dilate(m_reach, m_next, a, b);
+        for (int y = a; y <= b; ++y)
+        {
+            for (int w = 0; w < WORDS; ++w)
+            {
+                Word r = m_reach[y][w] | (m_next[y][w] & m_free[y][w]);
+                if (r == m_reach[y][w]) continue;
+                m_reach[y][w] = r;
+                changed = true;
+                if (y < y1) y1 = y;
+                if (y > y2) y2 = y;
+            }
+        }
+    }
+
+    int area = 0;
+    for (int y = y1; y <= y2; ++y)
+    {
+        for (int w = 0; w < WORDS; ++w) area += __builtin_popcountll(m_reach[y][w]);
+    }
+    return area;
+}
+
+void SpaceEval::territory(const Position *pos, int count, int *area)
+{
+    /* m_reach holds all claimed cells; m_fronts the cells each player
+       claimed in the last step. */
+    m_fronts.assign((size_t)count*SIZE*WORDS, 0);
+    Row *fronts = (Row*)&m_fronts[0];
+    memset(m_reach, 0, sizeof(m_reach));
+    int y1 = SIZE, y2 = -1;
+    for (int i = 0; i < count; ++i)
+    {
+        area[i] = 0;
+        int cx, cy;
+        if (!cell_of(pos[i], &cx, &cy)) continue;
+        fronts[SIZE*i + cy][cx/64] |= 1ull << cx%64;
+        m_reach[cy][cx/64] |= 1ull << cx%64;
+        if (cy < y1) y1 = cy;
+        if (cy > y2) y2 = cy;
+    }
+    if (y1 > y2) return;
+
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+        int a = y1 > 0 ? y1 - 1 : 0, b = y2 + 1 < SIZE ? y2 + 1 : SIZE - 1;
+
+        /* Cells reached by two or more players in the same step are
+           claimed by nobody (but block all of them). */
+        Row *once = m_next, *twice = m_twice, *grown = m_grown;
+        memset(once + a, 0, sizeof(Row)*(b - a + 1));
+        memset(twice + a, 0, sizeof(Row)*(b - a + 1));
+        for (int i = 0; i < count; ++i)
+        {
+            Row *front = fronts + SIZE*i;
+            dilate(front, grown, a, b);
+            for (int y = a; y <= b; ++y)
+            {
+                for (int w = 0; w < WORDS; ++w)
+                {
+                    Word g = grown[y][w] & m_free[y][w] & ~m_reach[y][w];
+                    front[y][w] = g;
+                    twice[y][w] |= once[y][w] & g;
+                    once[y][w] |= g;
+                }
+            }
+        }
+
+        for (int y = a; y <= b; ++y)
+        {
+            for (int w = 0; w < WORDS; ++w)
+            {
+                if (once[y][w] == 0) continue;
+                m_reach[y][w] |= once[y][w];
+                changed = true;
+                if (y < y1) y1 = y;
+                if (y > y2) y2 = y;
+                for (int i = 0; i < count; ++i)
+                {
+                    Word &f = fronts[SIZE*i + y][w];
+                    f &= ~twice[y][w];
+                    area[i] += __builtin_popcountll(f);
+                }
+            }
+        }
+    }
+}
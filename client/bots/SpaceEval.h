@@ -0,0 +1,73 @@
+#ifndef SPACE_EVAL_H_INCLUDED
+#define SPACE_EVAL_H_INCLUDED
+
+#include <client/PlayerController.h>
+#include <vector>
+
+/* Estimates free space on the field for bots.
+
+   Keeps a coarse occupancy grid of the field (one bit per CELL x CELL block
+   of pixels, set if any pixel in the block is free of lines), which is
+   updated incrementally: bots report the line segments drawn (e.g. from
+   watch_player()) and only the affected blocks are re-read from the field
+   on the next call to update().
+
+   Flood fills operate on 64 cells at a time, using bitwise operations on
+   whole rows of the grid. */
+class SpaceEval
+{
+public:
+    typedef unsigned long long Word;
+
+    enum {
+        CELL  = 16,                     /* pixels per cell (in each dimension) */
+        SIZE  = FIELD_SIZE/CELL,        /* cells per row/column */
+        WORDS = (SIZE + 63)/64          /* words per row */
+    };
+
+    SpaceEval();
+
+    /* Marks all cells as free (i.e. for an empty field). */
+    void clear();
+
+    /* Marks the cells covered by a segment (drawn `line_width' wide) or by
+       a rectangle of pixels as changed. */
+    void invalidate(const Position &p, const Position &q, double line_width);
+    void invalidate(const Rect &rect);
+
+    /* Marks all cells as changed. */
+    void invalidate_all();
+
+    /* Re-reads changed cells from the field. */
+    void update(const Field &field);
+
+    /* Returns whether the cell containing `pos' is free. */
+    bool is_free(const Position &pos) const;
+
+    /* Returns the number of free cells reachable from the cell containing
+       `pos' (which itself counts as free, since it usually contains the
+       player's own head). */
+    int reachable(const Position &pos);
+
+    /* Computes the Voronoi territory of `count' players at the given
+       positions: stores in `area[i]' the number of free cells that player i
+       reaches strictly before all others (moving one cell per step). */
+    void territory(const Position *pos, int count, int *area);
+
+private:
+    typedef Word Row[WORDS];
+
+    static bool cell_of(const Position &pos, int *cx, int *cy);
+    static void dilate(const Row *src, Row *dst, int y1, int y2);
+
+    Row m_free[SIZE];           /* free cells */
+    Row m_dirty[SIZE];          /* cells to be re-read from the field */
+    int m_dirty_y1, m_dirty_y2; /* rows containing dirty cells */
+    Row m_reach[SIZE];          /* scratch space for flood fills */
+    Row m_next[SIZE];
+    Row m_twice[SIZE];
+    Row m_grown[SIZE];
+    std::vector<Word> m_fronts; /* per-player frontiers for territory() */
+};
+
+#endif /* ndef SPACE_EVAL_H_INCLUDED */
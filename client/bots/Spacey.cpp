@@ -0,0 +1,109 @@
+#include "SimpleSearch.h"
+#include "SpaceEval.h"
+#include "Prediction.h"
+#include <math.h>
+#include <algorithm>
+
+/* A bot that steers towards the largest territory: for each move, it looks
+   a short distance ahead and counts the free cells it would reach before any
+   other player, discounted by the chance that another player crosses its
+   path there. Moves are then tried in order of territory by SimpleSearch,
+   which picks the first one that survives longest. */
+class Spacey : public SimpleSearch
+{
+public:
+    Spacey() : predictor(NULL) { }
+    ~Spacey() { Predictor::release(predictor); }
+
+    void restart(const GameParameters &gp)
+    {
+        space.clear();
+        Predictor::release(predictor);
+        predictor = Predictor::acquire(gp.gameid);
+        SimpleSearch::restart(gp);
+    }
+
+    void field_changed(const std::vector<FieldChange> &changes)
+    {
+        SimpleSearch::field_changed(changes);
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            space.invalidate(changes[i].rect);
+        }
+    }
+
+    void watch_player( int player_index, int timestamp, Move move,
+        double move_rate, double turn_rate, bool solid,
+        const Position &p, const Position &q )
+    {
+        (void)turn_rate;     // unused
+        (void)solid;         // unused
+        (void)p;             // unused
+        (void)q;             // unused
+        if (predictor != NULL)
+        {
+            predictor->watch(player_index, timestamp, move, move_rate);
+        }
+    }
+
+    Move move( int timestamp, const Player *players,
+               int player_index, const Field &field )
+    {
+        if (timestamp >= gp.warmup && predictor != NULL)
+        {
+            space.update(field);
+            predictor->predict( timestamp, players, player_index,
+                                gp, &prediction );
+
+            /* Start positions: mine first, then the other players' */
+            std::vector<Position> pos(1);
+            for (int n = 0; n < gp.num_players; ++n)
+            {
+                if (n != player_index && !players[n].dead)
+                {
+                    pos.push_back(ahead(players[n].ppos));
+                }
+            }
+
+            std::pair<int, Move> order[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                Position p = players[player_index].ppos;
+                for (int pass = 0; pass < lookahead; ++pass)
+                {
+                    position_update(&p, moves[i], gp.move_rate, gp.turn_rate);
+                }
+                pos[0] = ahead(p);
+                int area[256];
+                space.territory(&pos[0], (int)pos.size(), area);
+
+                /* Avoid places that other players are likely to cross */
+                double risk = prediction.probability(p);
+                order[i] = std::make_pair( -(int)(area[0]*(1 - risk)),
+                                           moves[i] );
+            }
+            std::stable_sort(order, order + 3);
+            for (int i = 0; i < 3; ++i) moves[i] = order[i].second;
+        }
+        return SimpleSearch::move(timestamp, players, player_index, field);
+    }
+
+private:
+    /* Returns a position just ahead of the player's head, so that it is not
+       in a cell occupied by the player's own line. */
+    Position ahead(const Position &p)
+    {
+        double d = gp.line_width + (double)SpaceEval::CELL/FIELD_SIZE;
+        Position q = p;
+        q.x += d*cos(p.a);
+        q.y += d*sin(p.a);
+        return q;
+    }
+
+    static const int lookahead = 8;     /* moves to look ahead */
+    SpaceEval space;
+    Predictor *predictor;   /* shared with other bots in the same game */
+    Prediction prediction;
+};
+
+extern "C" PlayerController *create_bot() { return new Spacey; }
@@ -0,0 +1,117 @@
+#include "SimpleSearch.h"
+#include "SpaceEval.h"
+#include <math.h>
+#include <algorithm>
+
+/* A batched version of Spacey, for clients that run several players with
+   the same bot (named e.g. "Squad-1" and "Squad-2"). A single instance
+   controls all of them: the occupancy pyramid, transposition table and
+   territory grid are kept once and updated once per frame, and the other
+   players' positions are looked up only once. Only move ordering and search
+   are done per player. Teammates count as opponents when calculating
+   territory, so the squad tends to spread out over the field. */
+class Squad : public SimpleSearch
+{
+public:
+    bool threaded() { return false; }
+    bool batched() { return true; }
+
+    void restart(const GameParameters &gp)
+    {
+        space.clear();
+        SimpleSearch::restart(gp);
+    }
+
+    void field_changed(const std::vector<FieldChange> &changes)
+    {
+        SimpleSearch::field_changed(changes);
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            space.invalidate(changes[i].rect);
+        }
+    }
+
+    Move move( int timestamp, const Player *players,
+               int player_index, const Field &field )
+    {
+        Move m;
+        move_batch(timestamp, players, &player_index, 1, field, &m);
+        return m;
+    }
+
+    void move_batch( int timestamp, const Player *players,
+                     const int *player_indices, int count,
+                     const Field &field, Move *moves_out )
+    {
+        /* Shared work: bring the territory grid up to date, and find the
+           positions ahead of all living players. */
+        std::vector<Position> heads;
+        std::vector<int> owners;
+        if (timestamp >= gp.warmup)
+        {
+            space.update(field);
+            for (int n = 0; n < gp.num_players; ++n)
+            {
+                if (players[n].dead) continue;
+                heads.push_back(ahead(players[n].ppos));
+                owners.push_back(n);
+            }
+        }
+
+        /* Split the search time between players */
+        budget = squad_budget/count;
+
+        for (int i = 0; i < count; ++i)
+        {
+            int player_index = player_indices[i];
+            if (timestamp >= gp.warmup)
+            {
+                /* Start positions: mine first, then the other players' */
+                std::vector<Position> pos(1);
+                for (size_t k = 0; k < heads.size(); ++k)
+                {
+                    if (owners[k] != player_index) pos.push_back(heads[k]);
+                }
+
+                std::pair<int, Move> order[3];
+                for (int j = 0; j < 3; ++j)
+                {
+                    Position p = players[player_index].ppos;
+                    for (int pass = 0; pass < lookahead; ++pass)
+                    {
+                        position_update( &p, moves[j],
+                                         gp.move_rate, gp.turn_rate );
+                    }
+                    pos[0] = ahead(p);
+                    int area[256];
+                    space.territory(&pos[0], (int)pos.size(), area);
+                    order[j] = std::make_pair(-area[0], moves[j]);
+                }
+                std::stable_sort(order, order + 3);
+                for (int j = 0; j < 3; ++j) moves[j] = order[j].second;
+            }
+            moves_out[i] = SimpleSearch::move( timestamp, players,
+                                               player_index, field );
+        }
+    }
+
+private:
+    /* Returns a position just ahead of the player's head, so that it is not
+       in a cell occupied by the player's own line. */
+    Position ahead(const Position &p)
+    {
+        double d = gp.line_width + (double)SpaceEval::CELL/FIELD_SIZE;
+        Position q = p;
+        q.x += d*cos(p.a);
+        q.y += d*sin(p.a);
+        return q;
+    }
+
+    static const int lookahead = 8;         /* moves to look ahead */
+    static const double squad_budget;       /* search time per frame */
+    SpaceEval space;
+};
+
+const double Squad::squad_budget = 0.008;
+
+extern "C" PlayerController *create_bot() { return new Squad; }
@@ -1,12 +1,16 @@
 #include "common.h"
 #include "Audio.h"
+#include "BotProcess.h"
+#include "BotThread.h"
 #include "ClientSocket.h"
+#include "ClockSync.h"
 #include "Config.h"
 #include "GameModel.h"
 #include "MainWindow.h"
 #include "KeyboardPlayerController.h"
 #include "ScoreView.h"
 #include <algorithm>
+#include <deque>
 #include <vector>
 #include <string>
 #include <utility>
@@ -22,9 +26,23 @@
 
 #ifdef WIN32
 #include <shlobj.h>
+#else
+#include <signal.h>
 #endif
 
-#define CLIENT_FPS 100
+#define IDLE_FPS 20     /* timed events per second while no game runs */
+
+/* Timing statistics for a local player controller */
+struct MoveStats
+{
+    Move    last_move;      /* last move returned (or repeated) */
+    double  tick_time;      /* time spent in move() during this tick */
+    double  total_time;     /* time spent in move() since last report */
+    double  max_time;       /* slowest move() call since last report */
+    int     moves;          /* move() calls since last report */
+    int     overruns;       /* calls exceeding the deadline since last report */
+    int     skipped;        /* moves repeated since last report */
+};
 
 /* Global variables*/
 MainWindow *g_window;   /* main window */
@@ -35,15 +53,23 @@ int g_feats;            /* protocol features used */
 
 int g_server_timestamp;   /* last timestamp received */
 int g_local_timestamp;    /* local estimated timestamp */
-double g_server_time;     /* estimated server time at timestamp 0 */
+ClockSync g_clock;        /* estimated timing of server frames */
+std::deque<std::string> g_sent_moves;   /* recently sent moves (one string
+                                           per timestamp up to local time) */
 
 std::vector<std::string> g_my_names;    /* my player names */
 std::vector<int>         g_my_players;  /* indices of my players in g_players */
 std::vector<int>         g_my_indices;
 std::vector<PlayerController*> g_my_controllers;
+std::vector<MoveStats>   g_my_move_stats;   /* timing of g_my_controllers */
+std::vector<AsyncController*> g_my_async;  /* asynchronous bots (or NULL) */
+std::vector<std::vector<FieldChange> > g_my_changes;  /* for field_changed() */
+std::vector<int>         g_my_batch;    /* player sharing my batched bot
+                                           instance (or -1 if not batched) */
 std::vector<int>         g_my_keys;     /* all keys in use */
 
 std::vector<Player>      g_players;         /* all players in the game */
+std::vector<HoleSchedule> g_hole_schedules; /* .. and when they make holes */
 std::vector<std::string> g_names;           /* .. and their names */
 
 double g_frame_time;     /* time at which frame counter was last reset */
@@ -77,6 +103,14 @@ static bool player_update_prediction(int n, Move move)
     return true;
 }
 
+/* Returns whether local player n has its own controller instance, or is the
+   first of the players sharing a batched bot instance; notifications are
+   passed only to these, so that each instance receives them once. */
+static bool controls_instance(size_t n)
+{
+    return g_my_batch[n] < 0 || g_my_batch[n] == (int)n;
+}
+
 static void update_sprites()
 {
     for (int n = 0; n < g_gp.num_players; ++n)
@@ -115,10 +149,42 @@ static void handle_FEAT(unsigned char *buf, size_t len)
     for (int n = 0; n < g_config.players(); ++n)
     {
         PlayerController *pc = NULL;
+        AsyncController *ac = NULL;
+        int batch = -1;
 
-        if (g_feats & FEAT_BOTS)
+        /* Players using the same batched bot share its instance */
+        for (int m = 0; m < n && (g_feats & FEAT_BOTS); ++m)
         {
-            pc = PlayerController::load_bot(g_config.name(n).c_str());
+            if ( g_my_batch[m] == m &&
+                 PlayerController::bot_name(g_my_names[m]) ==
+                 PlayerController::bot_name(g_config.name(n)) )
+            {
+                pc = g_my_controllers[m];
+                batch = m;
+            }
+        }
+
+        if ((g_feats & FEAT_BOTS) && pc == NULL)
+        {
+#ifndef WIN32
+            std::string bot = PlayerController::bot_name(g_config.name(n));
+            if (g_config.sandbox_bots())
+            {
+                ac = BotProcess::start(bot.c_str());
+                if (ac != NULL) pc = new SandboxedController();
+            }
+#endif
+            if (pc == NULL)
+            {
+                pc = PlayerController::load_bot(g_config.name(n).c_str());
+#ifndef WIN32
+                if (pc != NULL && g_config.sandbox_bots())
+                {
+                    warn( "could not run bot %s in a bot host; "
+                          "loaded it into the client instead", bot.c_str() );
+                }
+#endif
+            }
         }
 
         if (pc == NULL)
@@ -129,7 +195,13 @@ static void handle_FEAT(unsigned char *buf, size_t len)
             g_my_keys.push_back(key_left);
             g_my_keys.push_back(key_right);
         }
+        if (batch < 0 && ac == NULL && pc->batched()) batch = n;
         g_my_controllers.push_back(pc);
+        g_my_move_stats.push_back(MoveStats());
+        if (ac == NULL && batch < 0 && pc->threaded()) ac = new BotThread(pc);
+        g_my_async.push_back(ac);
+        g_my_changes.push_back(std::vector<FieldChange>());
+        g_my_batch.push_back(batch);
         g_my_names.push_back(g_config.name(n));
     }
 
@@ -198,7 +270,11 @@ static void handle_CHAT(unsigned char *buf, size_t len)
     /* Send to player controllers */
     for (size_t n = 0; n < g_my_controllers.size(); ++n)
     {
-        if (name != g_my_names[n]) g_my_controllers[n]->listen(name, text);
+        if (name == g_my_names[n] || !controls_instance(n)) continue;
+        if (g_my_async[n] != NULL)
+            g_my_async[n]->listen(name, text);
+        else
+            g_my_controllers[n]->listen(name, text);
     }
 }
 
@@ -250,7 +326,10 @@ static void handle_STRT(unsigned char *buf, size_t len)
     info("Restarting game with %d players", g_gp.num_players);
     g_server_timestamp = 0;
     g_local_timestamp = 0;
+    g_clock.reset(g_gp.data_rate);
+    g_sent_moves.clear();
     g_players = std::vector<Player>(g_gp.num_players);
+    g_hole_schedules = std::vector<HoleSchedule>(g_gp.num_players);
     g_names   = std::vector<std::string>(g_gp.num_players);
     g_my_players = std::vector<int>(g_my_names.size(), -1);
     g_my_indices = std::vector<int>(g_gp.num_players, -1);
@@ -295,8 +374,9 @@ static void handle_STRT(unsigned char *buf, size_t len)
         info( "Player %d: name=%s x=%.3f y=%.3f a=%.3f", n, g_players[n].name,
               g_players[n].pos.x, g_players[n].pos.y, g_players[n].pos.a );
         g_players[n].timestamp = 0;
-        g_players[n].rng_base  = n^g_gp.gameid;
-        g_players[n].rng_carry = 0;
+        g_players[n].hole      = 0;
+        HoleParams params = hole_params(g_gp);
+        hole_schedule_init(&g_hole_schedules[n], &params, g_gp.gameid, n);
 
         for (int m = 0; m < (int)g_my_names.size(); ++m)
         {
@@ -327,10 +407,14 @@ static void handle_STRT(unsigned char *buf, size_t len)
     g_window->gameView()->setWarmup(true);
 
     /* Reinitialize controllers */
-    std::vector<PlayerController*>::iterator it;
-    for (it = g_my_controllers.begin(); it != g_my_controllers.end(); ++it)
+    for (size_t n = 0; n < g_my_controllers.size(); ++n)
     {
-        (*it)->restart(g_gp);
+        g_my_changes[n].clear();
+        if (!controls_instance(n)) continue;
+        if (g_my_async[n] != NULL)
+            g_my_async[n]->restart(g_gp);
+        else
+            g_my_controllers[n]->restart(g_gp);
     }
 
     /* Acknowledge game start */
@@ -396,15 +480,8 @@ static void player_move(int n, Move move)
         g_window->gameView()->setSpriteLabel(n, g_players[n].name);
     }
 
-    /* Change hole making state according to RNG */
-    if ( pl.hole == 0 && pl.timestamp >= g_gp.warmup + g_gp.hole_cooldown &&
-         pl.timestamp - pl.solid_since >= g_gp.hole_cooldown &&
-         pl.rng_base%g_gp.hole_probability == 0 )
-    {
-        pl.hole = g_gp.hole_length_min +
-                 pl.rng_base/g_gp.hole_probability %
-                 (g_gp.hole_length_max - g_gp.hole_length_min + 1);
-    }
+    /* Look up hole making state */
+    pl.hole = hole_schedule_hole(&g_hole_schedules[n], pl.timestamp);
 
     switch (move)
     {
@@ -419,7 +496,16 @@ static void player_move(int n, Move move)
             position_update(&npos, move, move_rate, turn_rate);
             if (move_rate > 0 && pl.hole == 0)
             {
-                g_window->gameView()->drawLine(&pl.pos, &npos, n);
+                FieldChange fc = { n, pl.pos, npos, Rect() };
+                g_window->gameView()->drawLine(&pl.pos, &npos, n, &fc.rect);
+                for (size_t m = 0; m < g_my_async.size(); ++m)
+                {
+                    if (g_my_async[m] != NULL)
+                        g_my_async[m]->drawLine(pl.pos, npos, n);
+                    else
+                    if (controls_instance(m))
+                        g_my_changes[m].push_back(fc);
+                }
             }
         } break;
 
@@ -441,8 +527,17 @@ static void player_move(int n, Move move)
     /* Notify controllers of move (useful for bots): */
     for (size_t m = 0; m < g_my_controllers.size(); ++m)
     {
-        g_my_controllers[m]->watch_player( n, pl.timestamp, move,
-            move_rate, turn_rate, pl.hole == 0, pl.pos, npos );
+        if (!controls_instance(m)) continue;
+        if (g_my_async[m] != NULL)
+        {
+            g_my_async[m]->watch_player( n, pl.timestamp, move,
+                move_rate, turn_rate, pl.hole == 0, pl.pos, npos );
+        }
+        else
+        {
+            g_my_controllers[m]->watch_player( n, pl.timestamp, move,
+                move_rate, turn_rate, pl.hole == 0, pl.pos, npos );
+        }
     }
 
     /* Update common player state: */
@@ -456,20 +551,47 @@ static void player_move(int n, Move move)
     }
 #endif
 
-    /* Update RNG */
-    unsigned long long rng_next = pl.rng_base*1967773755ull + pl.rng_carry;
-    pl.rng_base  = rng_next&0xffffffff;
-    pl.rng_carry = rng_next>>32;
+    /* Increment player timestamp */
+    pl.timestamp++;
+}
 
-    /* Count down hole */
-    if (pl.hole > 0)
+/* Sends my players' moves for the current local timestamp. If the server
+   supports timestamped moves, moves sent recently are repeated (up to the
+   backlog set by the server) so that lost packets are recovered from. */
+static void send_moves(const std::string &moves)
+{
+    if (!(g_feats & FEAT_MOVE_TIMESTAMPS))
     {
-        --pl.hole;
-        if (pl.hole == 0) pl.solid_since = pl.timestamp + 1;
+        std::string packet(1, (char)MRCS_MOVE);
+        packet += moves;
+        g_cs->write(packet.data(), packet.size(), false);
+        return;
     }
 
-    /* Increment player timestamp */
-    pl.timestamp++;
+    size_t backlog = 1;
+    if (!g_cs->reliable_only() && g_gp.move_backlog > 1)
+    {
+        backlog = std::min(g_gp.move_backlog, 255);
+    }
+    g_sent_moves.push_back(moves);
+    while (g_sent_moves.size() > backlog) g_sent_moves.pop_front();
+
+    int first = g_local_timestamp + 1 - (int)g_sent_moves.size();
+    std::string packet;
+    packet += (char)MRCS_MOVT;
+    packet += (char)(first >> 24);
+    packet += (char)(first >> 16);
+    packet += (char)(first >>  8);
+    packet += (char)(first >>  0);
+    packet += (char)g_sent_moves.size();
+    for (size_t p = 0; p < moves.size(); ++p)
+    {
+        for (size_t i = 0; i < g_sent_moves.size(); ++i)
+        {
+            packet += g_sent_moves[i][p];
+        }
+    }
+    g_cs->write(packet.data(), packet.size(), false);
 }
 
 static void forward_to(int timestamp)
@@ -490,15 +612,69 @@ static void forward_to(int timestamp)
     if (!have_players)
     {
         g_local_timestamp = timestamp;
+        g_sent_moves.clear();
         return;
     }
 
+    /* Each bot may spend up to the deadline in move() per tick (or waiting for
+       its worker thread); after that, its last move is repeated so a slow bot
+       cannot stall the client. */
+    const double deadline = 1e-3*g_config.bot_deadline();
+    for (size_t n = 0; n < g_my_move_stats.size(); ++n)
+    {
+        g_my_move_stats[n].tick_time = 0;
+    }
+
     while (g_local_timestamp < timestamp)
     {
-        /* Create new move packet: */
-        char packet[1 + g_my_players.size()];
-        size_t packet_len = 0;
-        packet[packet_len++] = MRCS_MOVE;
+        /* New moves of my players */
+        std::string moves;
+
+        /* Let batched bots calculate moves for all their players at once */
+        Move batch_moves[g_my_players.size()];
+        for (size_t n = 0; n < g_my_players.size(); ++n)
+        {
+            if (g_my_batch[n] != (int)n) continue;
+
+            int indices[g_my_players.size()], members[g_my_players.size()];
+            int count = 0;
+            for (size_t k = n; k < g_my_players.size(); ++k)
+            {
+                int p = g_my_players[k];
+                if (g_my_batch[k] != (int)n || p < 0 || g_players[p].dead)
+                {
+                    continue;
+                }
+                batch_moves[k] = g_my_move_stats[k].last_move;
+                indices[count] = p;
+                members[count] = (int)k;
+                ++count;
+            }
+
+            MoveStats &ms = g_my_move_stats[n];
+            if (count == 0) continue;
+            if (ms.tick_time >= deadline)
+            {
+                /* Time budget exhausted: fall back to last moves */
+                ++ms.skipped;
+                continue;
+            }
+
+            PlayerController *pc = g_my_controllers[n];
+            Move results[g_my_players.size()];
+            double t = time_now();
+            pc->field_changed(g_my_changes[n]);
+            g_my_changes[n].clear();
+            pc->move_batch( g_local_timestamp, &g_players[0],
+                            indices, count, field, results );
+            t = time_now() - t;
+            ms.tick_time  += t;
+            ms.total_time += t;
+            if (t > ms.max_time) ms.max_time = t;
+            if (t > deadline) ++ms.overruns;
+            ++ms.moves;
+            for (int i = 0; i < count; ++i) batch_moves[members[i]] = results[i];
+        }
 
         for (size_t n = 0; n < g_my_players.size(); ++n)
         {
@@ -509,9 +685,59 @@ static void forward_to(int timestamp)
             Move m = MOVE_FORWARD;
             if (!g_players[p].dead)
             {
-                /* Use player controller to get next move */
                 PlayerController *pc = g_my_controllers[n];
-                m = pc->move(g_local_timestamp, &g_players[0], p, field);
+                AsyncController *bt = g_my_async[n];
+                MoveStats &ms = g_my_move_stats[n];
+                if (g_my_batch[n] >= 0)
+                {
+                    /* Calculated above */
+                    m = batch_moves[n];
+                }
+                else
+                if (bt != NULL)
+                {
+                    /* Request move from worker thread, and wait for it (or an
+                       earlier request's late result) while within budget. */
+                    double latency, t = time_now();
+                    bt->request_move(g_local_timestamp, g_players, p);
+                    bool ready = bt->wait_move( deadline - ms.tick_time,
+                                                &m, &latency );
+                    ms.tick_time += time_now() - t;
+                    if (ready)
+                    {
+                        ms.total_time += latency;
+                        if (latency > ms.max_time) ms.max_time = latency;
+                        if (latency > deadline) ++ms.overruns;
+                        ++ms.moves;
+                    }
+                    else
+                    {
+                        m = ms.last_move;
+                        ++ms.skipped;
+                    }
+                }
+                else
+                if (pc->human() || ms.tick_time < deadline)
+                {
+                    /* Use player controller to get next move */
+                    double t = time_now();
+                    pc->field_changed(g_my_changes[n]);
+                    g_my_changes[n].clear();
+                    m = pc->move(g_local_timestamp, &g_players[0], p, field);
+                    t = time_now() - t;
+                    ms.tick_time  += t;
+                    ms.total_time += t;
+                    if (t > ms.max_time) ms.max_time = t;
+                    if (t > deadline && !pc->human()) ++ms.overruns;
+                    ++ms.moves;
+                }
+                else
+                {
+                    /* Time budget exhausted: fall back to last move */
+                    m = ms.last_move;
+                    ++ms.skipped;
+                }
+                ms.last_move = m;
             }
             player_update_prediction(p, m);
 
@@ -522,26 +748,57 @@ static void forward_to(int timestamp)
                 g_window->gameView()->setWarmup(false);
             }
 
-            packet[packet_len++] = (char)m;
+            moves += (char)m;
         }
 
         /* Process chat messages */
         std::string text;
         for (size_t n = 0; n < g_my_controllers.size(); ++n)
         {
-            while (g_my_controllers[n]->retrieve_message(&text))
+            if (!controls_instance(n)) continue;
+            while (g_my_async[n] != NULL ?
+                   g_my_async[n]->retrieve_message(&text) :
+                   g_my_controllers[n]->retrieve_message(&text))
             {
                 send_chat_message(g_my_names[n], text);
             }
         }
 
-        /* Send new move packet */
-        g_cs->write(packet, packet_len, false);
+        send_moves(moves);
 
         ++g_local_timestamp;
     }
 }
 
+/* Reports bot move timing in the stats overlay, and resets the counters. */
+static void report_move_stats()
+{
+    std::string text;
+    for (size_t n = 0; n < g_my_controllers.size(); ++n)
+    {
+        MoveStats &ms = g_my_move_stats[n];
+        if (!g_my_controllers[n]->human() && controls_instance(n))
+        {
+            char line[128];
+            snprintf( line, sizeof(line), "%s: %.1f/%.1f ms",
+                      g_my_names[n].c_str(),
+                      ms.moves > 0 ? 1e3*ms.total_time/ms.moves : 0.0,
+                      1e3*ms.max_time );
+            text += line;
+            if (ms.overruns > 0 || ms.skipped > 0)
+            {
+                snprintf( line, sizeof(line), " (%d late, %d skipped)",
+                          ms.overruns, ms.skipped );
+                text += line;
+            }
+            text += '\n';
+        }
+        ms.total_time = ms.max_time = 0;
+        ms.moves = ms.overruns = ms.skipped = 0;
+    }
+    g_window->setBotStats(text.c_str());
+}
+
 static void handle_FFWD(unsigned char *buf, size_t len)
 {
     if (len < 5 + (size_t)g_gp.num_players)
@@ -559,7 +816,9 @@ static void handle_FFWD(unsigned char *buf, size_t len)
         return;
     }
     g_local_timestamp = g_server_timestamp = timestamp;
-    g_server_time = time_now() - 1.0*g_server_timestamp/g_gp.data_rate;
+    g_clock.reset(g_gp.data_rate);
+    g_sent_moves.clear();
+    g_clock.frame_received(g_server_timestamp, time_now());
 
     /* Decode compressed player moves */
     size_t pos = 5;
@@ -606,12 +865,10 @@ static void handle_MOVE(unsigned char *buf, size_t len)
     }
 
     /* Update estimated server time */
-    {
-        double t = time_now() - 1.0*g_server_timestamp/g_gp.data_rate;
-        if (g_server_timestamp == 1 || t < g_server_time) g_server_time = t;
-    }
+    g_clock.frame_received(g_server_timestamp, time_now());
 
     /* Update moves */
+    int my_timestamp = -1;  /* timestamp of the earliest own move */
     for (size_t pos = 1; pos < len; pos += 2)
     {
         size_t n = buf[pos];
@@ -627,11 +884,22 @@ static void handle_MOVE(unsigned char *buf, size_t len)
         }
         else
         {
+            if ( g_my_indices[n] != -1 && m != MOVE_DEAD &&
+                 (my_timestamp == -1 || g_players[n].timestamp < my_timestamp) )
+            {
+                my_timestamp = g_players[n].timestamp;
+            }
             player_move(n, (Move)m);
             if (g_my_indices[n] == -1) player_reset_prediction(n);
         }
     }
 
+    /* Check if my moves arrived in time */
+    if (my_timestamp != -1)
+    {
+        g_clock.move_processed(my_timestamp, g_server_timestamp);
+    }
+
     update_sprites();
 }
 
@@ -654,32 +922,57 @@ static void handle_packet(unsigned char *buf, size_t len)
     }
 }
 
-void callback(void *arg)
+static void network_callback(int fd, void *arg)
 {
+    (void)fd;
+    (void)arg;
+
     /* Read network input */
-    unsigned char buf[4096];
+    unsigned char *buf;
     ssize_t len;
-    while ((len = g_cs->read(buf, sizeof(buf) - 1)) > 0)
+    while ((len = g_cs->read(&buf)) > 0)
     {
         handle_packet(buf, (size_t)len);
     }
-    if (len < 0) error("ClientSocket::read() failed!");
+    if (len < 0)
+    {
+        error("ClientSocket::read() failed!");
+        Fl::remove_fd(g_cs->stream_socket());
+        if (!g_cs->reliable_only()) Fl::remove_fd(g_cs->packet_socket());
+    }
+
+    /* Catch up if the estimated server time moved back */
+    if (g_server_timestamp > 0)
+    {
+        int timestamp = g_clock.send_timestamp(time_now());
+        if (timestamp > g_local_timestamp)
+        {
+            forward_to(timestamp);
+            update_sprites();
+        }
+    }
+}
 
+static void frame_callback(void *arg)
+{
     /* Do timed events */
-    g_window->gameView()->updateTime(time_now());
+    double t = time_now();
+    g_window->gameView()->updateTime(t);
 
+    double delay = 1.0/IDLE_FPS;
     if (g_server_timestamp > 0)
     {
-        /* Estimate server timestamp */
-        double t = time_now();
-        int server_timestamp = (int)floor((t - g_server_time)*g_gp.data_rate);
-        forward_to(server_timestamp + 1);
+        /* Send the moves that are due, and wake up again when the next
+           move must be sent */
+        forward_to(g_clock.send_timestamp(t));
         update_sprites();
+
+        double next = g_clock.send_time(g_local_timestamp) + 1e-4;
+        delay = std::max(0.0, std::min(delay, next - time_now()));
     }
 
     /* Calculate FPS */
     g_frame_counter += 1;
-    double t = time_now();
     if (t > g_frame_time + 1)
     {
         if (g_frame_time > 0)
@@ -692,13 +985,14 @@ void callback(void *arg)
             g_cs->get_bytes_received(), g_cs->get_packets_received(),
             g_cs->get_bytes_sent(), g_cs->get_packets_sent() );
         g_cs->clear_stats();
+        report_move_stats();
     }
 
 #ifdef WITH_AUDIO
     if (g_audio) g_audio->update();
 #endif
 
-    Fl::repeat_timeout(1.0/CLIENT_FPS, callback, arg);
+    Fl::add_timeout(delay, frame_callback, arg);
 }
 
 static void disconnect()
@@ -777,6 +1071,16 @@ int main(int argc, char *argv[])
     time_reset();
     srand(time(NULL));
 
+#ifndef WIN32
+    /* Ignore SIGPIPE, so writing to a closed socket or a crashed bot host
+       fails with EPIPE instead of killing the client */
+    struct sigaction sa;
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGPIPE, &sa, NULL);
+#endif
+
     Fl::visual(FL_DOUBLE|FL_INDEX);
 
     /* Configuration */
@@ -787,7 +1091,8 @@ int main(int argc, char *argv[])
         g_config.save_settings(config_path.c_str());
 
         /* Initialize requested protocol features:*/
-        g_feats = FEAT_BOTS | FEAT_NODELAY;
+        g_feats = FEAT_BOTS | FEAT_NODELAY | FEAT_MOVE_TIMESTAMPS;
+        if (g_config.players() == 0) g_feats |= FEAT_SPECTATOR;
 
         /* Try to connect to the server */
         g_cs = new ClientSocket( g_config.hostname().c_str(), g_config.port(),
@@ -815,7 +1120,13 @@ int main(int argc, char *argv[])
     g_window = new MainWindow(800, 600, g_config.fullscreen(), g_config.antialiasing());
     g_window->show();
 
-    Fl::add_timeout(0, callback, NULL);
+    /* Handle packets as they arrive, and timed events per frame */
+    Fl::add_fd(g_cs->stream_socket(), FL_READ, network_callback, NULL);
+    if (!g_cs->reliable_only())
+    {
+        Fl::add_fd(g_cs->packet_socket(), FL_READ, network_callback, NULL);
+    }
+    Fl::add_timeout(0, frame_callback, NULL);
     Fl::run();
     disconnect();
     return 0;
@@ -120,21 +120,57 @@ static int draw_poly(Field *field, const Point *pts, int npt, int col)
 #define POOR(pt) (OOR(pt.x) || OOR(pt.y))
 #define OOR(x) ((x) < -100 || (x) > FIELD_SIZE+100)
 
-int field_line_th( Field *field, const Position *p, const Position *q,
-                   double th, int col, Rect *rect )
+/* Calculates the corners of the polygon covered by a line segment. */
+static void line_points( const Position *p, const Position *q, double th,
+                         Point pts[4] )
 {
     double dx1 = -sin(p->a), dy1 = cos(p->a);
     double dx2 = -sin(q->a), dy2 = cos(q->a);
 
-    Point pts[4] = {
-        { (int)(FIELD_SIZE*p->x + 0.5 - 0.5*th*dx1),
-          (int)(FIELD_SIZE*p->y + 0.5 - 0.5*th*dy1) },
-        { (int)(FIELD_SIZE*p->x + 0.5 + 0.5*th*dx1),
-          (int)(FIELD_SIZE*p->y + 0.5 + 0.5*th*dy1) },
-        { (int)(FIELD_SIZE*q->x + 0.5 + 0.5*th*dx2),
-          (int)(FIELD_SIZE*q->y + 0.5 + 0.5*th*dy2) },
-        { (int)(FIELD_SIZE*q->x + 0.5 - 0.5*th*dx2),
-          (int)(FIELD_SIZE*q->y + 0.5 - 0.5*th*dy2) } };
+    pts[0].x = (int)(FIELD_SIZE*p->x + 0.5 - 0.5*th*dx1);
+    pts[0].y = (int)(FIELD_SIZE*p->y + 0.5 - 0.5*th*dy1);
+    pts[1].x = (int)(FIELD_SIZE*p->x + 0.5 + 0.5*th*dx1);
+    pts[1].y = (int)(FIELD_SIZE*p->y + 0.5 + 0.5*th*dy1);
+    pts[2].x = (int)(FIELD_SIZE*q->x + 0.5 + 0.5*th*dx2);
+    pts[2].y = (int)(FIELD_SIZE*q->y + 0.5 + 0.5*th*dy2);
+    pts[3].x = (int)(FIELD_SIZE*q->x + 0.5 - 0.5*th*dx2);
+    pts[3].y = (int)(FIELD_SIZE*q->y + 0.5 - 0.5*th*dy2);
+}
+
+/* Calculates the bounding rectangle of a polygon, clipped to the field. */
+static void points_rect(const Point pts[4], Rect *rect)
+{
+    int n;
+    rect->x1 = rect->x2 = pts[0].x;
+    rect->y1 = rect->y2 = pts[0].y;
+    for (n = 1; n < 4; ++n)
+    {
+        if (pts[n].x < rect->x1) rect->x1 = pts[n].x;
+        if (pts[n].x > rect->x2) rect->x2 = pts[n].x;
+        if (pts[n].y < rect->y1) rect->y1 = pts[n].y;
+        if (pts[n].y > rect->y2) rect->y2 = pts[n].y;
+    }
+    rect->x2 += 1;
+    rect->y2 += 1;
+    if (rect->x1 < 0) rect->x1 = 0;
+    if (rect->y1 < 0) rect->y1 = 0;
+    if (rect->x2 > FIELD_SIZE) rect->x2 = FIELD_SIZE;
+    if (rect->y2 > FIELD_SIZE) rect->y2 = FIELD_SIZE;
+}
+
+void field_line_rect( const Position *p, const Position *q, double th,
+                      Rect *rect )
+{
+    Point pts[4];
+    line_points(p, q, th, pts);
+    points_rect(pts, rect);
+}
+
+int field_line_th( Field *field, const Position *p, const Position *q,
+                   double th, int col, Rect *rect )
+{
+    Point pts[4];
+    line_points(p, q, th, pts);
 
     /* For debugging: */
     if (POOR(pts[0]) || POOR(pts[1]) || POOR(pts[2]) || POOR(pts[3]))
@@ -149,26 +185,7 @@ int field_line_th( Field *field, const Position *p, const Position *q,
         printf("\n\n");
     }
 
-    if (rect != NULL)
-    {
-        int n;
-        rect->x1 = rect->x2 = pts[0].x;
-        rect->y1 = rect->y2 = pts[0].y;
-        for (n = 1; n < 4; ++n)
-        {
-            if (pts[n].x < rect->x1) rect->x1 = pts[n].x;
-            if (pts[n].x > rect->x2) rect->x2 = pts[n].x;
-            if (pts[n].y < rect->y1) rect->y1 = pts[n].y;
-            if (pts[n].y > rect->y2) rect->y2 = pts[n].y;
-        }
-        rect->x2 += 1;
-        rect->y2 += 1;
-        if (rect->x1 < 0) rect->x1 = 0;
-        if (rect->y1 < 0) rect->y1 = 0;
-        if (rect->x2 > FIELD_SIZE) rect->x2 = FIELD_SIZE;
-        if (rect->y2 > FIELD_SIZE) rect->y2 = FIELD_SIZE;
-    }
+    if (rect != NULL) points_rect(pts, rect);
 
     return draw_poly(field, pts, 4, col);
 }
-
@@ -31,6 +31,11 @@ typedef struct Rect
 int field_line_th( Field *field, const Position *p, const Position *q,
                    double th, int col, Rect *rect );
 
+/* Calculates the rectangle of pixels that field_line_th() would affect when
+   drawing the given line segment. */
+void field_line_rect( const Position *p, const Position *q, double th,
+                      Rect *rect );
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,93 @@
+#include "HoleSchedule.h"
+#include <string.h>
+
+/* Computes the window starting at frame `first', continuing from the state
+   at the end of the previous window. */
+static void fill_window(HoleSchedule *hs, int first)
+{
+    const HoleParams *p = &hs->params;
+    int range = p->length_max - p->length_min + 1, i;
+    if (range < 1) range = 1;
+
+    hs->first = first;
+    for (i = 0; i < HOLE_WINDOW; ++i)
+    {
+        int t = first + i;
+        unsigned long long rng_next;
+
+        /* Same rules as do_player_move() in the server */
+        if ( hs->remaining == 0 && p->probability > 0 &&
+             t >= p->warmup + p->cooldown &&
+             t - hs->solid_since >= p->cooldown &&
+             hs->rng_base%p->probability == 0 )
+        {
+            hs->remaining = p->length_min +
+                            hs->rng_base/p->probability%range;
+        }
+        hs->hole[i] = (unsigned char)hs->remaining;
+
+        rng_next = hs->rng_base*1967773755ull + hs->rng_carry;
+        hs->rng_base  = rng_next&0xffffffff;
+        hs->rng_carry = rng_next>>32;
+
+        if (hs->remaining > 0)
+        {
+            --hs->remaining;
+            if (hs->remaining == 0) hs->solid_since = t + 1;
+        }
+    }
+}
+
+/* Computes the first window, starting from the initial state. */
+static void rewind_schedule(HoleSchedule *hs)
+{
+    hs->rng_base    = hs->seed;
+    hs->rng_carry   = 0;
+    hs->remaining   = 0;
+    hs->solid_since = 0;
+    fill_window(hs, 0);
+}
+
+void hole_schedule_init( HoleSchedule *hs, const HoleParams *params,
+                         unsigned gameid, int player_index )
+{
+    memset(hs, 0, sizeof(*hs));
+    hs->params = *params;
+    hs->seed   = gameid ^ (unsigned)player_index;
+    rewind_schedule(hs);
+}
+
+int hole_schedule_hole(HoleSchedule *hs, int t)
+{
+    if (t < 0) return 0;
+    if (t < hs->first) rewind_schedule(hs);
+    while (t >= hs->first + HOLE_WINDOW)
+    {
+        fill_window(hs, hs->first + HOLE_WINDOW);
+    }
+    return hs->hole[t - hs->first];
+}
+
+bool hole_schedule_in_hole(HoleSchedule *hs, int t)
+{
+    return hole_schedule_hole(hs, t) > 0;
+}
+
+int hole_schedule_next(HoleSchedule *hs, int t, int end, int *length)
+{
+    int prev, cur;
+
+    if (hs->params.probability <= 0) return -1;
+    if (t < 0) t = 0;
+    prev = hole_schedule_hole(hs, t - 1);
+    for (; t < end; ++t, prev = cur)
+    {
+        cur = hole_schedule_hole(hs, t);
+        if (cur > 0 && cur + 1 != prev)
+        {
+            if (length != NULL) *length = cur;
+            return t;
+        }
+    }
+    return -1;
+}
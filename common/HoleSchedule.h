@@ -0,0 +1,70 @@
+#ifndef HOLE_SCHEDULE_H_INCLUDED
+#define HOLE_SCHEDULE_H_INCLUDED
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* When players make holes is determined by a multiply-with-carry RNG per
+   player, seeded with the game id and the player's index, and does not
+   depend on the moves made. A hole schedule computes these frames ahead of
+   time, so whether a player is in a hole at a given frame can be looked up
+   directly instead of replaying the RNG.
+
+   Frames are computed in windows of HOLE_WINDOW frames. Lookups in the
+   current window take constant time; moving the window forward takes
+   HOLE_WINDOW steps of the RNG, while moving it back restarts from frame 0.
+   The structure does not allocate memory, so it may be copied freely. */
+
+#define HOLE_WINDOW 1024
+
+/* Hole parameters (see GameParameters in the client) */
+typedef struct HoleParams
+{
+    int warmup;         /* warmup frames (no holes before warmup + cooldown) */
+    int probability;    /* inverse probability of a hole starting */
+    int length_min;     /* minimum length of a hole (in frames) */
+    int length_max;     /* maximum length of a hole (in frames) */
+    int cooldown;       /* minimum number of frames between holes */
+} HoleParams;
+
+typedef struct HoleSchedule
+{
+    HoleParams params;
+    unsigned seed;                      /* initial RNG value */
+
+    int first;                          /* first frame in window */
+    unsigned char hole[HOLE_WINDOW];    /* remaining hole length per frame
+                                           (including that frame), or 0 */
+
+    /* State at frame first + HOLE_WINDOW */
+    unsigned rng_base, rng_carry;       /* RNG state */
+    int remaining;                      /* remaining length of hole */
+    int solid_since;                    /* first frame after last hole */
+} HoleSchedule;
+
+/* Initializes the hole schedule of the player with the given index for the
+   game with the given id. */
+void hole_schedule_init( HoleSchedule *hs, const HoleParams *params,
+                         unsigned gameid, int player_index );
+
+/* Returns the number of frames of the hole that the player is making at
+   frame `t' (counting frame `t' itself), or 0 if the player's line is solid
+   at that frame. */
+int hole_schedule_hole(HoleSchedule *hs, int t);
+
+/* Returns whether the player is making a hole at frame `t'. */
+bool hole_schedule_in_hole(HoleSchedule *hs, int t);
+
+/* Returns the first frame `f' with t <= f < end at which a new hole starts,
+   and stores its length in `length' (if not NULL). Returns -1 if no hole
+   starts in that range. */
+int hole_schedule_next(HoleSchedule *hs, int t, int end, int *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ndef HOLE_SCHEDULE_H_INCLUDED */
@@ -0,0 +1,179 @@
+#include "Occupancy.h"
+#include <math.h>
+#include <string.h>
+
+void occupancy_clear(Occupancy *occ)
+{
+    memset(occ, 0, sizeof(*occ));
+}
+
+void occupancy_rebuild(Occupancy *occ, const Field *field)
+{
+    Rect rect = { 0, 0, FIELD_SIZE, FIELD_SIZE };
+    occupancy_update(occ, field, &rect);
+}
+
+/* Returns whether any pixel in the 8x8 block at (bx, by) is occupied. */
+static unsigned char block_occupied(const Field *field, int bx, int by)
+{
+    int x1 = 8*bx, y1 = 8*by, x2 = x1 + 8, y2 = y1 + 8, x, y;
+    if (x2 > FIELD_SIZE) x2 = FIELD_SIZE;
+    if (y2 > FIELD_SIZE) y2 = FIELD_SIZE;
+    for (y = y1; y < y2; ++y)
+    {
+        const unsigned char *row = (*field)[y];
+        if (x2 - x1 == 8)
+        {
+            /* Test 8 pixels at once */
+            unsigned long long pixels;
+            memcpy(&pixels, row + x1, sizeof(pixels));
+            if (pixels != 0) return 1;
+        }
+        else
+        {
+            for (x = x1; x < x2; ++x) if (row[x] != 0) return 1;
+        }
+    }
+    return 0;
+}
+
+void occupancy_update(Occupancy *occ, const Field *field, const Rect *rect)
+{
+    int x1 = rect->x1, y1 = rect->y1, x2 = rect->x2, y2 = rect->y2, x, y;
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 > FIELD_SIZE) x2 = FIELD_SIZE;
+    if (y2 > FIELD_SIZE) y2 = FIELD_SIZE;
+    if (x1 >= x2 || y1 >= y2) return;
+
+    /* Recalculate 8x8 blocks from the field */
+    for (y = y1/8; y <= (y2 - 1)/8; ++y)
+    {
+        for (x = x1/8; x <= (x2 - 1)/8; ++x)
+        {
+            occ->l8[y][x] = block_occupied(field, x, y);
+        }
+    }
+
+    /* Recalculate 32x32 blocks from the 8x8 blocks */
+    for (y = y1/32; y <= (y2 - 1)/32; ++y)
+    {
+        for (x = x1/32; x <= (x2 - 1)/32; ++x)
+        {
+            unsigned char any = 0;
+            int i, j;
+            for (i = 4*y; i < 4*y + 4 && i < OCC_SIZE_8; ++i)
+            {
+                for (j = 4*x; j < 4*x + 4 && j < OCC_SIZE_8; ++j)
+                {
+                    any |= occ->l8[i][j];
+                }
+            }
+            occ->l32[y][x] = any;
+        }
+    }
+
+    /* Recalculate 128x128 blocks from the 32x32 blocks */
+    for (y = y1/128; y <= (y2 - 1)/128; ++y)
+    {
+        for (x = x1/128; x <= (x2 - 1)/128; ++x)
+        {
+            unsigned char any = 0;
+            int i, j;
+            for (i = 4*y; i < 4*y + 4 && i < OCC_SIZE_32; ++i)
+            {
+                for (j = 4*x; j < 4*x + 4 && j < OCC_SIZE_32; ++j)
+                {
+                    any |= occ->l32[i][j];
+                }
+            }
+            occ->l128[y][x] = any;
+        }
+    }
+}
+
+/* Returns whether the pixels in rectangle (x1,y1)-(x2,y2) (inclusive) are
+   all free. */
+static bool pixels_empty(const Field *field, int x1, int y1, int x2, int y2)
+{
+    int x, y;
+    for (y = y1; y <= y2; ++y)
+    {
+        for (x = x1; x <= x2; ++x) if ((*field)[y][x] != 0) return false;
+    }
+    return true;
+}
+
+/* Returns whether the blocks of `size' pixels that overlap the
+   rectangle (x1,y1)-(x2,y2) (inclusive) are all empty, descending into the
+   next level for occupied blocks, and finally into the field's pixels
+   (if `field' is not NULL). */
+static bool region_empty( const Occupancy *occ, const Field *field, int size,
+                          int x1, int y1, int x2, int y2 )
+{
+    int bx, by;
+    for (by = y1/size; by <= y2/size; ++by)
+    {
+        for (bx = x1/size; bx <= x2/size; ++bx)
+        {
+            int sx1, sy1, sx2, sy2;
+
+            switch (size)
+            {
+            case 128:
+                if (!occ->l128[by][bx]) continue;
+                break;
+            case 32:
+                if (!occ->l32[by][bx]) continue;
+                break;
+            default:
+                if (!occ->l8[by][bx]) continue;
+                if (field == NULL) return false;
+                break;
+            }
+
+            /* Descend into the part of the block that overlaps */
+            sx1 = bx*size > x1 ? bx*size : x1;
+            sy1 = by*size > y1 ? by*size : y1;
+            sx2 = bx*size + size - 1 < x2 ? bx*size + size - 1 : x2;
+            sy2 = by*size + size - 1 < y2 ? by*size + size - 1 : y2;
+            if (size == 8)
+            {
+                if (!pixels_empty(field, sx1, sy1, sx2, sy2)) return false;
+            }
+            else
+            {
+                if (!region_empty(occ, field, size/4, sx1, sy1, sx2, sy2))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool occupancy_empty( const Occupancy *occ, const Field *field,
+                      const Rect *rect )
+{
+    if ( rect->x1 < 0 || rect->y1 < 0 ||
+         rect->x2 > FIELD_SIZE || rect->y2 > FIELD_SIZE ) return false;
+    if (rect->x1 >= rect->x2 || rect->y1 >= rect->y2) return true;
+    return region_empty( occ, field, 128, rect->x1, rect->y1,
+                         rect->x2 - 1, rect->y2 - 1 );
+}
+
+int occupancy_line_test( const Occupancy *occ, const Field *field,
+                         const Position *p, const Position *q, double th )
+{
+    /* A rectangle that certainly contains the segment's pixels, which is
+       cheaper to calculate than the exact polygon. */
+    double r = 0.5*th + 1;
+    Rect rect;
+    rect.x1 = (int)floor(FIELD_SIZE*(p->x < q->x ? p->x : q->x) - r);
+    rect.y1 = (int)floor(FIELD_SIZE*(p->y < q->y ? p->y : q->y) - r);
+    rect.x2 = (int)floor(FIELD_SIZE*(p->x > q->x ? p->x : q->x) + r) + 2;
+    rect.y2 = (int)floor(FIELD_SIZE*(p->y > q->y ? p->y : q->y) + r) + 2;
+    if (occupancy_empty(occ, field, &rect)) return 0;
+    return field_line_th((Field*)field, p, q, th, -1, NULL);
+}
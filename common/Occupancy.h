@@ -0,0 +1,54 @@
+#ifndef OCCUPANCY_H_INCLUDED
+#define OCCUPANCY_H_INCLUDED
+
+#include "Field.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Occupancy pyramid of a game field: for blocks of 8x8, 32x32 and 128x128
+   pixels, records whether any pixel in the block is occupied. This allows
+   collision tests in empty parts of the field to be answered with a few
+   lookups, instead of rasterizing line segments pixel by pixel. */
+
+#define OCC_SIZE_8   ((FIELD_SIZE +   7)/  8)
+#define OCC_SIZE_32  ((FIELD_SIZE +  31)/ 32)
+#define OCC_SIZE_128 ((FIELD_SIZE + 127)/128)
+
+typedef struct Occupancy
+{
+    unsigned char l8[OCC_SIZE_8][OCC_SIZE_8];
+    unsigned char l32[OCC_SIZE_32][OCC_SIZE_32];
+    unsigned char l128[OCC_SIZE_128][OCC_SIZE_128];
+} Occupancy;
+
+/* Marks all blocks as empty (for an empty field). */
+void occupancy_clear(Occupancy *occ);
+
+/* Recalculates all blocks from the given field. */
+void occupancy_rebuild(Occupancy *occ, const Field *field);
+
+/* Recalculates the blocks overlapping `rect' from the given field; this
+   should be called for the rectangle returned by field_line_th() after
+   drawing a line segment. */
+void occupancy_update(Occupancy *occ, const Field *field, const Rect *rect);
+
+/* Returns whether `rect' lies completely inside the field, and none of its
+   pixels are occupied. If `field' is NULL, returns false for rectangles that
+   overlap an occupied 8x8 block, even if their own pixels are free;
+   otherwise, the overlapping pixels are tested individually. */
+bool occupancy_empty( const Occupancy *occ, const Field *field,
+                      const Rect *rect );
+
+/* Tests a line segment for collisions. Returns the same result as
+   field_line_th(field, p, q, th, -1, NULL), but much faster when the
+   segment lies in an empty part of the field. */
+int occupancy_line_test( const Occupancy *occ, const Field *field,
+                         const Position *p, const Position *q, double th );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ndef OCCUPANCY_H_INCLUDED */
@@ -0,0 +1,66 @@
+#include "PacketBuffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+int packet_buffer_init(PacketBuffer *pb, size_t size)
+{
+    pb->pos = 0;
+    pb->end = 0;
+    if (pb->data == NULL || pb->size != size)
+    {
+        free(pb->data);
+        pb->data = (unsigned char*)malloc(size);
+        pb->size = pb->data != NULL ? size : 0;
+    }
+    return pb->data != NULL;
+}
+
+void packet_buffer_free(PacketBuffer *pb)
+{
+    free(pb->data);
+    pb->data = NULL;
+    pb->size = 0;
+    pb->pos  = 0;
+    pb->end  = 0;
+}
+
+unsigned char *packet_buffer_space(PacketBuffer *pb, size_t *size)
+{
+    if (pb->pos == pb->end)
+    {
+        /* Everything processed; start at the front again */
+        pb->pos = pb->end = 0;
+    }
+    else
+    if ( pb->pos > 0 && ( pb->end == pb->size ||
+                          pb->pos >= pb->size/2 ) )
+    {
+        /* Move the unprocessed data to the front */
+        memmove(pb->data, pb->data + pb->pos, pb->end - pb->pos);
+        pb->end -= pb->pos;
+        pb->pos  = 0;
+    }
+    *size = pb->size - pb->end;
+    return pb->data + pb->end;
+}
+
+void packet_buffer_commit(PacketBuffer *pb, size_t size)
+{
+    pb->end += size;
+}
+
+int packet_buffer_next( PacketBuffer *pb, size_t max_len,
+                        unsigned char **data, size_t *len )
+{
+    size_t n;
+
+    if (pb->end - pb->pos < 2) return 0;
+    n = 256*pb->data[pb->pos] + pb->data[pb->pos + 1];
+    if (n < 1 || n > max_len || n + 2 > pb->size) return -1;
+    if (pb->end - pb->pos < n + 2) return 0;
+
+    *data = pb->data + pb->pos + 2;
+    *len  = n;
+    pb->pos += n + 2;
+    return 1;
+}
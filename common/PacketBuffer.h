@@ -0,0 +1,64 @@
+#ifndef PACKET_BUFFER_H_INCLUDED
+#define PACKET_BUFFER_H_INCLUDED
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reassembles packets received over a stream connection, where each packet
+   is preceded by its length as a 16-bit big-endian integer.
+
+   Data is received directly into the buffer (see packet_buffer_space() and
+   packet_buffer_commit()) and complete packets are returned as pointers into
+   the buffer, so no data is copied for packets that are handled right away.
+   Unprocessed data is moved to the front of the buffer only when the buffer
+   is full or more than half of it has been processed, instead of after
+   every packet, so each byte is moved only a bounded number of times.
+
+   The data is allocated separately, with a capacity chosen by the owner: it
+   must hold at least one packet of the maximum length plus its header, and
+   a small multiple of that lets several packets be received at once. A
+   zero-filled PacketBuffer is valid, but has no data allocated yet. */
+
+typedef struct PacketBuffer
+{
+    unsigned char *data;    /* received data (NULL if not allocated) */
+    size_t size;            /* capacity of data */
+    size_t pos;             /* start of unprocessed data */
+    size_t end;             /* end of received data */
+} PacketBuffer;
+
+/* Empties the buffer, and allocates data with the given capacity (unless
+   the buffer already has that capacity). Returns 0 if out of memory, in
+   which case the buffer has no data allocated, or 1 otherwise. */
+int packet_buffer_init(PacketBuffer *pb, size_t size);
+
+/* Frees the data of the buffer (which may be reused with packet_buffer_init)
+   and leaves the buffer empty. */
+void packet_buffer_free(PacketBuffer *pb);
+
+/* Returns where the next received data should be stored, and stores the
+   number of bytes available there in `size' (which is at least 1 unless the
+   buffer is full of unprocessed data). Invalidates packets returned before. */
+unsigned char *packet_buffer_space(PacketBuffer *pb, size_t *size);
+
+/* Marks `size' bytes stored at packet_buffer_space() as received. */
+void packet_buffer_commit(PacketBuffer *pb, size_t size);
+
+/* Retrieves the next complete packet. Returns 1 and stores its location and
+   length in `data' and `len' if one is available, 0 if more data must be
+   received first, or -1 if the packet length is invalid (less than 1 or
+   more than `max_len' or than fits in the buffer). The packet data remains valid until the next call
+   to packet_buffer_space() or packet_buffer_init(), and must not be modified:
+   a packet may end at the last byte of the buffer, and is followed by the
+   next packet's header otherwise. */
+int packet_buffer_next( PacketBuffer *pb, size_t max_len,
+                        unsigned char **data, size_t *len );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ndef PACKET_BUFFER_H_INCLUDED */
@@ -12,6 +12,7 @@ typedef enum Message
     MRCS_CHAT =   3,
     MRCS_STRT =   4,
     MRCS_MOVE =   5,
+    MRCS_MOVT =   6,
 
     /* reliable server->client */
     MRSC_FEAT =  64,
@@ -43,7 +44,9 @@ typedef enum Move
 #define FEAT_NODELAY        (1)
 #define FEAT_BOTS           (2)
 #define FEAT_UNRELIABLE     (4)
-#define FEAT_ALL            (7)
+#define FEAT_MOVE_TIMESTAMPS (8)
+#define FEAT_SPECTATOR     (16)
+#define FEAT_ALL           (31)
 
 /* Player flags. Set in HELO message. */
 #define PLFL_NONE   (0)
@@ -0,0 +1,120 @@
+#include "SimBots.h"
+#include "../client/PlayerController.h"
+#include <common/Debug.h>
+#include <common/Field.h>
+#include <common/Movement.h>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* A bot controlling a simulated player */
+struct SimBot
+{
+    SimBot() : pc(NULL) { }
+
+    PlayerController *pc;
+    std::string name;
+    std::vector<FieldChange> changes;   /* drawn since the last move() */
+};
+
+static std::vector<SimBot> g_bots;
+static std::vector<Player> g_players;
+static GameParameters g_gp;
+
+bool sim_bot_load(int i, const char *name)
+{
+    if ((int)g_bots.size() <= i) g_bots.resize(i + 1);
+    SimBot &bot = g_bots[i];
+    delete bot.pc;
+    bot.name = name;
+    bot.pc   = PlayerController::load_bot(name);
+    return bot.pc != NULL;
+}
+
+void sim_bots_restart(const SimGame *game, const Position *start)
+{
+    g_gp.gameid           = game->gameid;
+    g_gp.data_rate        = game->fps;
+    g_gp.turn_rate        = 2.0*M_PI/game->turn_rate;
+    g_gp.move_rate        = 1e-3*game->move_rate;
+    g_gp.line_width       = 1e-3*game->line_width;
+    g_gp.warmup           = game->warmup;
+    g_gp.score_rounds     = game->score_history;
+    g_gp.hole_probability = game->hole_probability;
+    g_gp.hole_length_min  = game->hole_length_min;
+    g_gp.hole_length_max  = game->hole_length_max;
+    g_gp.hole_cooldown    = game->hole_cooldown;
+    g_gp.move_backlog     = 0;
+    g_gp.num_players      = game->num_players;
+
+    g_players.resize(game->num_players);
+    for (int n = 0; n < game->num_players; ++n)
+    {
+        Player &pl = g_players[n];
+        memset(&pl, 0, sizeof(pl));
+        pl.pos  = pl.ppos = start[n];
+        pl.name = n < (int)g_bots.size() ? g_bots[n].name.c_str() : "";
+    }
+
+    for (size_t n = 0; n < g_bots.size(); ++n)
+    {
+        g_bots[n].changes.clear();
+        if (g_bots[n].pc != NULL) g_bots[n].pc->restart(g_gp);
+    }
+}
+
+Move sim_bot_move(int i, int timestamp, const Field *field)
+{
+    SimBot &bot = g_bots[i];
+    bot.pc->field_changed(bot.changes);
+    bot.changes.clear();
+    Move m = bot.pc->move(timestamp, &g_players[0], i, *field);
+    while (bot.pc->retrieve_message(NULL)) { }  /* nobody is listening */
+    if (m != MOVE_TURN_LEFT && m != MOVE_TURN_RIGHT) m = MOVE_FORWARD;
+    return m;
+}
+
+void sim_bots_watch( int i, int timestamp, Move m, double move_rate,
+                     int hole, const Position *p, const Position *q,
+                     const Rect *rect )
+{
+    Player &pl = g_players[i];
+    const bool solid = hole == 0;
+    pl.hole = hole;
+
+    if (move_rate > 0 && solid)
+    {
+        FieldChange fc = { i, *p, *q, *rect };
+        for (size_t n = 0; n < g_bots.size(); ++n)
+        {
+            if (!g_players[n].dead) g_bots[n].changes.push_back(fc);
+        }
+    }
+
+    for (size_t n = 0; n < g_bots.size(); ++n)
+    {
+        g_bots[n].pc->watch_player( i, timestamp, m, move_rate,
+                                    g_gp.turn_rate, solid, *p, *q );
+    }
+
+    pl.pos = pl.ppos = *q;
+    pl.last_move = m;
+    pl.timestamp = pl.pt = timestamp + 1;
+}
+
+void sim_bots_kill(int i)
+{
+    g_players[i].dead = true;
+}
+
+void sim_bots_free(void)
+{
+    for (size_t n = 0; n < g_bots.size(); ++n) delete g_bots[n].pc;
+    g_bots.clear();
+    g_players.clear();
+}
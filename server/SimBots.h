@@ -0,0 +1,61 @@
+#ifndef SIM_BOTS_H_INCLUDED
+#define SIM_BOTS_H_INCLUDED
+
+#include <common/Field.h>
+#include <common/Movement.h>
+#include <common/Protocol.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Players controlled by bots for the server's headless simulation mode.
+
+   Bots are loaded from bots/<name>.so with PlayerController::load_bot(),
+   just like the client does, and are passed the state of the server's game
+   directly instead of through a connection: the server reports each move it
+   executes and each death, and asks the bots for their moves in between.
+   All bots run on the calling thread. Player i in the game is controlled by
+   the bot loaded for player i. */
+
+/* Game parameters, as configured on the server */
+typedef struct SimGame
+{
+    unsigned gameid;
+    int fps, turn_rate, move_rate, line_width, warmup, score_history;
+    int hole_probability, hole_length_min, hole_length_max, hole_cooldown;
+    int num_players;
+} SimGame;
+
+/* Loads the bot that controls player `i'. The player name is used as with
+   PlayerController::load_bot(), so "Spacey-2" loads the Spacey bot. Returns
+   false if the bot could not be loaded. */
+bool sim_bot_load(int i, const char *name);
+
+/* Starts a new game. `start' holds the starting positions of the players
+   (in field coordinates, with angles in radians). */
+void sim_bots_restart(const SimGame *game, const Position *start);
+
+/* Asks the bot of player `i' for its move at `timestamp'. */
+Move sim_bot_move(int i, int timestamp, const Field *field);
+
+/* Reports that player `i' made move `m' at `timestamp', moving from `p' to
+   `q' at the given move rate. `hole' is the remaining length of the hole
+   being made (or 0); if it is 0 and the player moved, the line drew the
+   pixels in `rect' on the field. */
+void sim_bots_watch( int i, int timestamp, Move m, double move_rate,
+                     int hole, const Position *p, const Position *q,
+                     const Rect *rect );
+
+/* Reports that player `i' died. */
+void sim_bots_kill(int i);
+
+/* Unloads all bots. */
+void sim_bots_free(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ndef SIM_BOTS_H_INCLUDED */
@@ -0,0 +1,920 @@
+#include <common/Debug.h>
+#include <common/PacketBuffer.h>
+#include <common/Protocol.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+typedef int SOCKET;
+const SOCKET INVALID_SOCKET = -1;
+#else
+#include <winsock2.h>
+#define send(s,b,l,f) send(s,(char*)b,l,f)
+#define recv(s,b,l,f) recv(s,(char*)b,l,f)
+#define close(s) closesocket(s)
+#define ioctl(s,c,a) ioctlsocket(s,c,a)
+typedef int socklen_t;
+#endif
+
+#ifndef MAX_PATH
+#define MAX_PATH 4096
+#endif
+
+/* The relay connects to a game server as a spectator, and forwards the game
+   to any number of spectators connected to the relay. It keeps just enough
+   state (the last STRT and SCOR messages and the moves made in the current
+   game) to bring viewers that join halfway up to date, exactly like the
+   server does, so viewers cannot tell the difference. Viewers may not join
+   players; their moves and chat messages are ignored.
+
+   Optionally, the relay also writes the game to a live stream of segment
+   files and a manifest per game, which can be served as static files (see
+   doc/stream.txt). */
+
+/* Compile-time relay parameters: */
+#define MAX_PACKET_LEN     (16384)
+#define STREAM_BUFFER_SIZE (2*(MAX_PACKET_LEN + 2))  /* per connection */
+#define MAX_PLAYERS          (256)
+#define MAX_FF_LEN         (10000)
+#define RELAY_FEATS         (FEAT_NODELAY|FEAT_SPECTATOR)
+
+/* Configurable relay parameters: */
+static int RELAY_PORT        = 12322;
+static char SERVER_HOST[256] = "localhost";
+static int SERVER_PORT       = 12321;
+static char STREAM_DIR[MAX_PATH];       /* empty: no stream export */
+static int SEGMENT_SECONDS   =    10;
+
+typedef struct RelayPlayer
+{
+    unsigned char   *ff_buf;        /* compressed moves made in this game */
+    int             ff_len;         /* movement data length */
+    int             ff_size;        /* allocated buffer size */
+    bool            dead;           /* has the player died? */
+} RelayPlayer;
+
+/* Viewers are allocated when they connect, and freed at the start of the
+   next iteration of the main loop after they disconnect. */
+typedef struct Viewer
+{
+    int             id;             /* index in g_viewers */
+    bool            in_use;         /* is viewer connected? */
+    bool            joined;         /* have we received a JOIN? */
+    struct sockaddr_in sa_remote;
+    SOCKET          fd_stream;
+    PacketBuffer    stream;         /* received stream data */
+} Viewer;
+
+/* Upstream connection */
+static SOCKET g_fd_server = INVALID_SOCKET;
+static PacketBuffer g_server_stream;
+
+/* Downstream connections */
+static SOCKET g_fd_listen = INVALID_SOCKET;
+static Viewer **g_viewers;      /* Viewer slots (NULL if unused) */
+static int g_viewers_size;      /* Number of viewer slots allocated */
+static int g_num_viewers;       /* Number of connected viewers */
+
+/* State of the current game. Saved packets are preceded by room for their
+   length, like all packets passed to send_framed(). */
+static unsigned char g_strt_data[2 + MAX_PACKET_LEN];
+static unsigned char * const g_strt = g_strt_data + 2;  /* last STRT */
+static size_t g_strt_len;                               /* 0: none */
+static unsigned char g_scor_data[2 + MAX_PACKET_LEN];
+static unsigned char * const g_scor = g_scor_data + 2;  /* last SCOR */
+static size_t g_scor_len;                               /* 0: none */
+static int g_timestamp;         /* server timestamp of the last MOVE */
+static int g_num_players;
+static RelayPlayer g_players[MAX_PLAYERS];
+
+/* Live stream export */
+static int g_segment_frames;    /* frames per segment in the current game */
+static int g_segment;           /* number of segments started in this game */
+static FILE *fp_manifest;       /* manifest of the current game */
+static FILE *fp_segment;        /* segment being written */
+static bool g_stream_failed;    /* could not write current game? */
+
+/* Packet being built (preceded by room for its 2-byte length) */
+static unsigned char packet_buf_data[2 + MAX_PACKET_LEN];
+static unsigned char * const packet_buf = packet_buf_data + 2;
+static size_t packet_len;
+
+
+/* Function definitions */
+
+static bool socket_set_blocking(SOCKET fd, bool val)
+{
+    /* Note that we set FIONBIO (NON-blocking IO!) iff val is false! */
+#ifdef WIN32
+    unsigned long v = !val;
+#else
+    int v = !val;
+#endif
+    return ioctl(fd, FIONBIO, &v) == 0;
+}
+
+static bool socket_set_nodelay(SOCKET fd, bool val)
+{
+#ifdef WIN32
+    BOOL v = val ? TRUE : FALSE;
+#else
+    int v = val;
+#endif
+    return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char*)&v, sizeof(v)) == 0;
+}
+
+/* Starts a new packet of the given type */
+static void packet_begin(int type)
+{
+    packet_buf[0] = type;
+    packet_len = 1;
+}
+
+/* Adds data to the packet (truncated if the packet is full) */
+static void packet_write(const void *data, size_t len)
+{
+    if (len > MAX_PACKET_LEN - packet_len) len = MAX_PACKET_LEN - packet_len;
+    memcpy(packet_buf + packet_len, data, len);
+    packet_len += len;
+}
+
+static void packet_write_byte(int value)
+{
+    unsigned char c = value;
+    packet_write(&c, 1);
+}
+
+/* Sends the given packet data (which must be preceded by two bytes of room
+   for the length) over a stream connection. Returns whether all data was
+   sent. */
+static bool send_framed(SOCKET fd, unsigned char *data, size_t len)
+{
+    data[-2] = len >> 8;
+    data[-1] = len & 255;
+    return send(fd, data - 2, len + 2, 0) == (ssize_t)(len + 2);
+}
+
+static void viewer_disconnect(Viewer *vw, const char *reason)
+{
+    if (!vw->in_use) return;
+
+    info( "disconnecting viewer %d at %s:%d (reason: %s)",
+          vw->id, inet_ntoa(vw->sa_remote.sin_addr),
+          ntohs(vw->sa_remote.sin_port), reason );
+
+    vw->in_use = false;
+    --g_num_viewers;
+
+    if (reason != NULL)
+    {
+        packet_begin(MRSC_QUIT);
+        packet_write(reason, strlen(reason));
+        send_framed(vw->fd_stream, packet_buf, packet_len);
+    }
+    close(vw->fd_stream);
+}
+
+/* Sends a packet to a viewer. Viewer sockets are non-blocking,
+   so a viewer that cannot keep up is disconnected instead of stalling the
+   relay for everyone else. */
+static void viewer_send(Viewer *vw, unsigned char *data, size_t len)
+{
+    if (!send_framed(vw->fd_stream, data, len))
+    {
+        /* we must not provide a reason, since the connection is unusable */
+        viewer_disconnect(vw, NULL);
+    }
+}
+
+/* Forwards a packet to all viewers that have joined */
+static void viewers_broadcast(unsigned char *data, size_t len)
+{
+    for (int n = 0; n < g_viewers_size; ++n)
+    {
+        Viewer *vw = g_viewers[n];
+        if (vw == NULL || !vw->in_use || !vw->joined) continue;
+        viewer_send(vw, data, len);
+    }
+}
+
+static Viewer *viewer_alloc(void)
+{
+    int n = 0;
+    while (n < g_viewers_size && g_viewers[n] != NULL) ++n;
+    if (n == g_viewers_size)
+    {
+        /* Grow the viewer table */
+        int size = g_viewers_size > 0 ? 2*g_viewers_size : 16;
+        Viewer **viewers = (Viewer**)realloc(g_viewers, size*sizeof(Viewer*));
+        if (viewers == NULL) return NULL;
+        memset(viewers + g_viewers_size, 0,
+               (size - g_viewers_size)*sizeof(Viewer*));
+        g_viewers      = viewers;
+        g_viewers_size = size;
+    }
+
+    Viewer *vw = (Viewer*)calloc(1, sizeof(Viewer));
+    if (vw == NULL) return NULL;
+    vw->id = n;
+    g_viewers[n] = vw;
+    return vw;
+}
+
+static void viewers_free_unused(void)
+{
+    for (int n = 0; n < g_viewers_size; ++n)
+    {
+        if (g_viewers[n] != NULL && !g_viewers[n]->in_use)
+        {
+            packet_buffer_free(&g_viewers[n]->stream);
+            free(g_viewers[n]);
+            g_viewers[n] = NULL;
+        }
+    }
+}
+
+/* Appends a byte of compressed movement data for the given player */
+static void ff_append_byte(RelayPlayer *pl, int value)
+{
+    if (pl->ff_len == MAX_FF_LEN) return;
+    if (pl->ff_len == pl->ff_size)
+    {
+        int size = pl->ff_size > 0 ? 2*pl->ff_size : 256;
+        if (size > MAX_FF_LEN) size = MAX_FF_LEN;
+        pl->ff_buf = (unsigned char*)realloc(pl->ff_buf, size);
+        if (pl->ff_buf == NULL) fatal("out of memory");
+        pl->ff_size = size;
+    }
+    pl->ff_buf[pl->ff_len++] = value;
+}
+
+/* Records a move for the given player (compressed as the server does) */
+static void ff_append_move(RelayPlayer *pl, Move m)
+{
+    if ( pl->ff_len > 0 &&
+         (pl->ff_buf[pl->ff_len - 1]&0xc0) == (m << 6) &&
+         (pl->ff_buf[pl->ff_len - 1]&0x3f) < 0x3f )
+    {
+        pl->ff_buf[pl->ff_len - 1] += 1;  /* increase current repeat count */
+    }
+    else
+    {
+        ff_append_byte(pl, (m << 6) + 1);  /* start new command */
+    }
+}
+
+/* Builds an FFWD message describing the moves made in the current game */
+static void build_FFWD(void)
+{
+    packet_begin(MRSC_FFWD);
+    packet_write_byte(g_timestamp >> 24);
+    packet_write_byte(g_timestamp >> 16);
+    packet_write_byte(g_timestamp >>  8);
+    packet_write_byte(g_timestamp >>  0);
+    for (int n = 0; n < g_num_players; ++n)
+    {
+        packet_write(g_players[n].ff_buf, g_players[n].ff_len);
+        if (g_players[n].dead) packet_write_byte((MOVE_DEAD<<6) + 1);
+        packet_write_byte(0);
+    }
+}
+
+/* Brings a viewer that just joined up to date */
+static void send_keyframe(Viewer *vw)
+{
+    if (g_strt_len == 0) return;  /* no game in progress */
+
+    viewer_send(vw, g_strt, g_strt_len);
+
+    build_FFWD();
+    if (vw->in_use) viewer_send(vw, packet_buf, packet_len);
+
+    if (g_scor_len > 0 && vw->in_use) viewer_send(vw, g_scor, g_scor_len);
+}
+
+/* Appends a packet to the stream segment being written (if any) */
+static void stream_write(const unsigned char *data, size_t len)
+{
+    unsigned char header[2] = { len >> 8, len & 255 };
+
+    if (fp_segment == NULL) return;
+    if ( fwrite(header, 2, 1, fp_segment) != 1 ||
+         fwrite(data, len, 1, fp_segment) != 1 )
+    {
+        warn("could not write stream segment; stream export stopped");
+        fclose(fp_segment);
+        fp_segment = NULL;
+        g_stream_failed = true;
+    }
+}
+
+/* Closes the stream of the current game (if any) */
+static void stream_end_game(void)
+{
+    if (fp_segment != NULL)
+    {
+        fclose(fp_segment);
+        fp_segment = NULL;
+    }
+    if (fp_manifest != NULL)
+    {
+        fprintf(fp_manifest, "END\n");
+        fclose(fp_manifest);
+        fp_manifest = NULL;
+    }
+    g_segment = 0;
+    g_stream_failed = false;
+}
+
+/* Opens a file in the stream directory, or returns NULL (with a warning) */
+static FILE *stream_open(const char *name, const char *mode)
+{
+    char path[MAX_PATH];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", STREAM_DIR, name)
+            >= sizeof(path))
+    {
+        warn("stream file path too long");
+        return NULL;
+    }
+    FILE *fp = fopen(path, mode);
+    if (fp == NULL) warn("could not open file \"%s\" for writing", path);
+    return fp;
+}
+
+/* Writes the name of the current game's manifest to current.txt. A new file
+   is written and renamed over the old one, so that viewers polling the file
+   never see a partially written name. */
+static void stream_set_current(const char *manifest)
+{
+    char path[MAX_PATH], tmp_path[MAX_PATH];
+    if ( (size_t)snprintf( path, sizeof(path), "%s/current.txt",
+                           STREAM_DIR ) >= sizeof(path) ||
+         (size_t)snprintf( tmp_path, sizeof(tmp_path), "%s/current.tmp",
+                           STREAM_DIR ) >= sizeof(tmp_path) )
+    {
+        warn("stream file path too long");
+        return;
+    }
+
+    FILE *fp = fopen(tmp_path, "wt");
+    if (fp == NULL)
+    {
+        warn("could not open file \"%s\" for writing", tmp_path);
+        return;
+    }
+    bool ok = fprintf(fp, "%s\n", manifest) > 0;
+    ok = fclose(fp) == 0 && ok;
+#ifdef WIN32
+    /* rename() does not replace existing files on Windows */
+    if (ok) remove(path);
+#endif
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        warn("could not update \"%s\"", path);
+        remove(tmp_path);
+    }
+}
+
+/* Starts a new stream segment with a keyframe describing the game so far,
+   which holds the moves from timestamp g_timestamp + 1 onwards. */
+static void stream_begin_segment(void)
+{
+    char name[64];
+    unsigned gameid = (g_strt[14] << 24) | (g_strt[15] << 16) |
+                      (g_strt[16] <<  8) | (g_strt[17] <<  0);
+
+    if (fp_manifest == NULL)
+    {
+        /* Start the stream of a new game */
+        sprintf(name, "game-%08x.txt", gameid);
+        fp_manifest = stream_open(name, "wt");
+        if (fp_manifest == NULL)
+        {
+            g_stream_failed = true;
+            return;
+        }
+        info("streaming game to \"%s/%s\"", STREAM_DIR, name);
+        g_segment_frames = SEGMENT_SECONDS*g_strt[1];
+        fprintf(fp_manifest, "%d %u %d %d\n", 1, gameid, (int)g_strt[1],
+                                              g_segment_frames);
+
+        /* Point viewers to the new game */
+        stream_set_current(name);
+    }
+
+    if (fp_segment != NULL) fclose(fp_segment);
+    sprintf(name, "game-%08x-%04d.bin", gameid, g_segment++);
+    fp_segment = stream_open(name, "wb");
+    if (fp_segment == NULL)
+    {
+        g_stream_failed = true;
+        return;
+    }
+
+    stream_write(g_strt, g_strt_len);
+    if (g_timestamp >= 0)
+    {
+        build_FFWD();
+        stream_write(packet_buf, packet_len);
+    }
+    if (g_scor_len > 0) stream_write(g_scor, g_scor_len);
+
+    fprintf(fp_manifest, "%s %d\n", name, g_timestamp + 1);
+    fflush(fp_manifest);
+}
+
+static void handle_viewer_FEAT(Viewer *vw, unsigned char *buf, size_t len)
+{
+    if (len < 6)
+    {
+        viewer_disconnect(vw, "(FEAT) truncated packet");
+        return;
+    }
+    if (buf[1] != 3)
+    {
+        viewer_disconnect(vw, "(FEAT) unsupported protocol (expected 3)");
+        return;
+    }
+    if ((buf[5] & FEAT_NODELAY) && !socket_set_nodelay(vw->fd_stream, 1))
+    {
+        warn("could not put TCP socket in undelayed mode");
+    }
+
+    packet_begin(MRSC_FEAT);
+    packet_write_byte(3);
+    packet_write_byte(0);
+    packet_write_byte(0);
+    packet_write_byte(0);
+    packet_write_byte(RELAY_FEATS);
+    viewer_send(vw, packet_buf, packet_len);
+}
+
+static void handle_viewer_JOIN(Viewer *vw, unsigned char *buf, size_t len)
+{
+    if (vw->joined) return;
+    if (len < 2)
+    {
+        viewer_disconnect(vw, "(JOIN) truncated packet");
+        return;
+    }
+    if (buf[1] != 0)
+    {
+        viewer_disconnect(vw, "(JOIN) this is a relay; only spectators "
+                              "may connect");
+        return;
+    }
+    vw->joined = true;
+    send_keyframe(vw);
+}
+
+static void handle_viewer_packet(Viewer *vw, unsigned char *buf, size_t len)
+{
+    switch ((int)buf[0])
+    {
+    case MRCS_FEAT: return handle_viewer_FEAT(vw, buf, len);
+    case MRCS_QUIT: return viewer_disconnect(vw, "viewer quit");
+    case MRCS_JOIN: return handle_viewer_JOIN(vw, buf, len);
+    case MRCS_CHAT:
+    case MRCS_STRT:
+    case MRCS_MOVE:
+    case MRCS_MOVT: return;  /* viewers are read-only */
+    default: viewer_disconnect(vw, "invalid packet type");
+    }
+}
+
+/* Sends a packet to the server, or exits if that fails */
+static void server_send(unsigned char *data, size_t len)
+{
+    if (!send_framed(g_fd_server, data, len)) fatal("send() to server failed");
+}
+
+static void handle_server_FEAT(unsigned char *buf, size_t len)
+{
+    if (len < 6) fatal("(FEAT) packet too short");
+    if (buf[1] != 3)
+    {
+        fatal("(FEAT) incompatible server protocol (%d; expected 3)", buf[1]);
+    }
+    if (!(buf[5] & FEAT_SPECTATOR))
+    {
+        warn("server does not support spectators; joining without players");
+    }
+
+    /* Join the game without any players */
+    packet_begin(MRCS_JOIN);
+    packet_write_byte(0);
+    server_send(packet_buf, packet_len);
+}
+
+static void handle_server_STRT(unsigned char *buf, size_t len)
+{
+    if (len < 18) fatal("(STRT) packet too short");
+
+    memcpy(g_strt, buf, len);
+    g_strt_len    = len;
+    g_scor_len    = 0;
+    g_timestamp   = -1;  /* the first MOVE message is for timestamp 0 */
+    g_num_players = buf[13];
+    for (int n = 0; n < g_num_players; ++n)
+    {
+        g_players[n].ff_len = 0;
+        g_players[n].dead   = false;
+    }
+    info("game %02x%02x%02x%02x started with %d players",
+         buf[14], buf[15], buf[16], buf[17], g_num_players);
+
+    /* Acknowledge the new game */
+    packet_begin(MRCS_STRT);
+    server_send(packet_buf, packet_len);
+}
+
+static void handle_server_FFWD(unsigned char *buf, size_t len)
+{
+    if (len < 5) fatal("(FFWD) packet too short");
+
+    g_timestamp = (buf[1] << 24) | (buf[2] << 16) | (buf[3] << 8) | buf[4];
+
+    size_t pos = 5;
+    for (int n = 0; n < g_num_players; ++n)
+    {
+        RelayPlayer *pl = &g_players[n];
+        pl->ff_len = 0;
+        pl->dead   = false;
+        for ( ; pos < len && buf[pos] != 0; ++pos)
+        {
+            if ((buf[pos] >> 6) == MOVE_DEAD)
+                pl->dead = true;
+            else
+                ff_append_byte(pl, buf[pos]);
+        }
+        if (pos == len) fatal("(FFWD) packet truncated");
+        ++pos;
+    }
+}
+
+static void handle_server_MOVE(unsigned char *buf, size_t len)
+{
+    ++g_timestamp;
+    for (size_t pos = 1; pos + 1 < len; pos += 2)
+    {
+        int n = buf[pos], m = buf[pos + 1];
+        if (n >= g_num_players) continue;
+        if (m == MOVE_DEAD)
+            g_players[n].dead = true;
+        else
+            ff_append_move(&g_players[n], (Move)m);
+    }
+}
+
+static void handle_server_packet(unsigned char *buf, size_t len)
+{
+    switch ((int)buf[0])
+    {
+    case MRSC_FEAT:
+        handle_server_FEAT(buf, len);
+        return;  /* not forwarded; viewers negotiate with the relay */
+
+    case MRSC_QUIT:
+        fatal("disconnected by server (reason: %.*s)", (int)len - 1, buf + 1);
+
+    case MRSC_STRT:
+        stream_end_game();
+        handle_server_STRT(buf, len);
+        break;
+
+    case MRSC_FFWD:
+        handle_server_FFWD(buf, len);
+        return;  /* viewers get their own when they join */
+
+    case MRSC_MOVE:
+        if ( STREAM_DIR[0] != '\0' && g_strt_len > 0 && !g_stream_failed &&
+             (fp_segment == NULL || (g_timestamp + 1)%g_segment_frames == 0) )
+        {
+            stream_begin_segment();
+        }
+        handle_server_MOVE(buf, len);
+        break;
+
+    case MRSC_SCOR:
+        memcpy(g_scor, buf, len);
+        g_scor_len = len;
+        break;
+
+    case MRSC_CHAT:
+        break;
+
+    default:
+        warn("unknown packet type %d received from server", (int)buf[0]);
+        return;
+    }
+
+    viewers_broadcast(buf, len);
+    stream_write(buf, len);
+    if (fp_segment != NULL && buf[0] == MRSC_MOVE) fflush(fp_segment);
+}
+
+static void connect_server(void)
+{
+    info("connecting to server %s port %d", SERVER_HOST, SERVER_PORT);
+
+    struct hostent *he = gethostbyname(SERVER_HOST);
+    if (he == NULL || he->h_addrtype != AF_INET)
+    {
+        fatal("could not resolve host \"%s\"", SERVER_HOST);
+    }
+
+    struct sockaddr_in sa_remote;
+    memset(&sa_remote, 0, sizeof(sa_remote));
+    sa_remote.sin_family = AF_INET;
+    sa_remote.sin_port   = htons(SERVER_PORT);
+    sa_remote.sin_addr   = *(struct in_addr*)he->h_addr;
+
+    g_fd_server = socket(PF_INET, SOCK_STREAM, 0);
+    if (g_fd_server == INVALID_SOCKET)
+    {
+        fatal("could not connect to server: socket() failed");
+    }
+    if (connect( g_fd_server, (struct sockaddr*)&sa_remote,
+                 sizeof(sa_remote) ) != 0)
+    {
+        fatal("could not connect to server: connect() failed");
+    }
+    if (!socket_set_nodelay(g_fd_server, 1))
+    {
+        warn("could not put TCP socket in undelayed mode");
+    }
+    if (!packet_buffer_init(&g_server_stream, STREAM_BUFFER_SIZE))
+    {
+        fatal("out of memory");
+    }
+
+    /* Request protocol features; we join after the server responds */
+    packet_begin(MRCS_FEAT);
+    packet_write_byte(3);
+    packet_write_byte(0);
+    packet_write_byte(0);
+    packet_write_byte(0);
+    packet_write_byte(FEAT_NODELAY|FEAT_SPECTATOR);
+    server_send(packet_buf, packet_len);
+}
+
+static void accept_viewer(void)
+{
+    struct sockaddr_in sa;
+    socklen_t sa_len = sizeof(sa);
+    int fd = accept(g_fd_listen, (struct sockaddr*)&sa, &sa_len);
+    if (fd < 0)
+    {
+        warn("accept() failed");
+        return;
+    }
+
+    Viewer *vw = NULL;
+#ifndef WIN32
+    /* select() cannot wait on higher-numbered descriptors */
+    if (fd < FD_SETSIZE)
+#endif
+    if (socket_set_blocking(fd, 0)) vw = viewer_alloc();
+    if (vw != NULL && !packet_buffer_init(&vw->stream, STREAM_BUFFER_SIZE))
+    {
+        vw = NULL;  /* unused slot is freed later */
+    }
+    if (vw == NULL)
+    {
+        warn( "rejecting connection from %s:%d",
+              inet_ntoa(sa.sin_addr), ntohs(sa.sin_port) );
+        close(fd);
+        return;
+    }
+
+    info( "accepted viewer from %s:%d in slot #%d",
+          inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), vw->id );
+    vw->sa_remote = sa;
+    vw->fd_stream = fd;
+    vw->in_use    = true;
+    ++g_num_viewers;
+}
+
+/* Receives data on a stream connection and returns the number of bytes
+   received (0 if the connection was closed, or -1 on error). */
+static ssize_t receive(SOCKET fd, PacketBuffer *pb)
+{
+    size_t space;
+    unsigned char *buf = packet_buffer_space(pb, &space);
+    ssize_t read = recv(fd, buf, space, 0);
+    if (read > 0) packet_buffer_commit(pb, read);
+    return read;
+}
+
+static int run(void)
+{
+    for (;;)
+    {
+        viewers_free_unused();
+
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(g_fd_server, &readfds);
+        FD_SET(g_fd_listen, &readfds);
+        int max_fd = g_fd_server > g_fd_listen ? g_fd_server : g_fd_listen;
+        for (int n = 0; n < g_viewers_size; ++n)
+        {
+            Viewer *vw = g_viewers[n];
+            if (vw == NULL || !vw->in_use) continue;
+            FD_SET(vw->fd_stream, &readfds);
+            if ((int)vw->fd_stream > max_fd) max_fd = vw->fd_stream;
+        }
+
+        if (select(max_fd + 1, &readfds, NULL, NULL, NULL) < 0)
+        {
+            error("select() failed");
+            continue;
+        }
+
+        /* Forward game data from the server */
+        if (FD_ISSET(g_fd_server, &readfds))
+        {
+            ssize_t read = receive(g_fd_server, &g_server_stream);
+            if (read <= 0)
+            {
+                fatal( "lost connection to server (%s)",
+                       read == 0 ? "EOF reached" : "recv() failed" );
+            }
+
+            unsigned char *buf;
+            size_t len;
+            int res;
+            while ((res = packet_buffer_next( &g_server_stream, MAX_PACKET_LEN,
+                                              &buf, &len )) != 0)
+            {
+                if (res < 0) fatal("invalid packet length received from server");
+                handle_server_packet(buf, len);
+            }
+        }
+
+        /* Accept new viewers */
+        if (FD_ISSET(g_fd_listen, &readfds)) accept_viewer();
+
+        /* Handle packets from viewers */
+        for (int n = 0; n < g_viewers_size; ++n)
+        {
+            Viewer *vw = g_viewers[n];
+            if (vw == NULL || !vw->in_use) continue;
+            if (!FD_ISSET(vw->fd_stream, &readfds)) continue;
+
+            ssize_t read = receive(vw->fd_stream, &vw->stream);
+            if (read <= 0)
+            {
+                viewer_disconnect(vw, read == 0 ? "EOF reached" : "recv() failed");
+                continue;
+            }
+
+            unsigned char *buf;
+            size_t len;
+            int res;
+            while ( vw->in_use &&
+                    (res = packet_buffer_next( &vw->stream, MAX_PACKET_LEN,
+                                               &buf, &len )) != 0 )
+            {
+                if (res < 0)
+                {
+                    viewer_disconnect(vw, "invalid packet length");
+                    break;
+                }
+                handle_viewer_packet(vw, buf, len);
+            }
+        }
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+"Usage: zatacka-relay [--port=<port>] [--server=<host>] [--server_port=<port>]\n"
+"                     [--stream_dir=<dir>] [--segment_secs=<seconds>]\n"
+"\n"
+"Connects to a Zatacka server as a spectator and relays the game to any\n"
+"number of spectators connecting to the given port (default: %d).\n"
+"If a stream directory is given, games are also written there as a live\n"
+"stream of segments of the given length (default: %d seconds).\n",
+            RELAY_PORT, SEGMENT_SECONDS);
+    exit(EXIT_FAILURE);
+}
+
+static int parse_port(const char *val)
+{
+    int port;
+    if (sscanf(val, "%i", &port) < 1 || port < 1 || port > 65535)
+    {
+        fatal("invalid port number: %s", val);
+    }
+    return port;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--port=", 7) == 0)
+        {
+            RELAY_PORT = parse_port(arg + 7);
+        }
+        else
+        if (strncmp(arg, "--server_port=", 14) == 0)
+        {
+            SERVER_PORT = parse_port(arg + 14);
+        }
+        else
+        if (strncmp(arg, "--server=", 9) == 0)
+        {
+            if (strlen(arg + 9) >= sizeof(SERVER_HOST))
+            {
+                fatal("server host name too long");
+            }
+            strcpy(SERVER_HOST, arg + 9);
+        }
+        else
+        if (strncmp(arg, "--stream_dir=", 13) == 0)
+        {
+            if (strlen(arg + 13) >= sizeof(STREAM_DIR))
+            {
+                fatal("stream directory path too long");
+            }
+            strcpy(STREAM_DIR, arg + 13);
+        }
+        else
+        if (strncmp(arg, "--segment_secs=", 15) == 0)
+        {
+            if ( sscanf(arg + 15, "%i", &SEGMENT_SECONDS) < 1 ||
+                 SEGMENT_SECONDS < 1 || SEGMENT_SECONDS > 3600 )
+            {
+                fatal("invalid segment length: %s", arg + 15);
+            }
+        }
+        else
+        {
+            usage();
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parse_args(argc, argv);
+
+#ifdef WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0)
+    {
+        fatal("WSAStartup failed!");
+    }
+#else
+    /* Mask SIGPIPE, so failed writes do not kill the relay */
+    struct sigaction sa;
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGPIPE, &sa, NULL);
+#endif
+
+    struct sockaddr_in sa_local;
+    memset(&sa_local, 0, sizeof(sa_local));
+    sa_local.sin_family = AF_INET;
+    sa_local.sin_port   = htons(RELAY_PORT);
+    sa_local.sin_addr.s_addr = INADDR_ANY;
+
+    /* Create TCP listening socket */
+    g_fd_listen = socket(PF_INET, SOCK_STREAM, 0);
+    if (g_fd_listen == INVALID_SOCKET)
+    {
+        fatal("could not create TCP socket: socket() failed");
+    }
+    if (bind(g_fd_listen, (struct sockaddr*)&sa_local, sizeof(sa_local)) != 0)
+    {
+        fatal("could not create TCP socket: bind() failed");
+    }
+    if (listen(g_fd_listen, 16) != 0)
+    {
+        fatal("could not create TCP socket: listen() failed");
+    }
+
+    connect_server();
+
+    /* Main loop */
+    return run();
+}
@@ -2,9 +2,12 @@
 #include <common/Colors.h>
 #include <common/Debug.h>
 #include <common/Field.h>
+#include <common/HoleSchedule.h>
 #include <common/Movement.h>
+#include <common/PacketBuffer.h>
 #include <common/Protocol.h>
 #include <common/Time.h>
+#include "SimBots.h"
 
 #include <assert.h>
 #include <ctype.h>
@@ -57,20 +60,22 @@ struct Option {
 };
 
 /* Compile-time server parameters: */
-#define MAX_CLIENTS           (64)
 #define MOVE_BACKLOG          (60)
+#define MOVE_QUEUE_SIZE       (64)  /* power of 2, at least MOVE_BACKLOG */
 #define MAX_PACKET_LEN     (16384)
+#define STREAM_BUFFER_SIZE (2*(MAX_PACKET_LEN + 2))  /* per client */
 #define MAX_NAME_LEN          (20)
 #define PLAYERS_PER_CLIENT     (4)
 #define MAX_SCORE_HISTORY   (1000)
 #define MAX_FF_LEN         (10000)
-#define SERVER_FEATS        (FEAT_NODELAY|FEAT_BOTS)
+#define SERVER_FEATS        (FEAT_NODELAY|FEAT_BOTS|FEAT_MOVE_TIMESTAMPS|\
+                             FEAT_SPECTATOR)
 #define CONFIG_FILENAME     "zatacka-server.conf"
 
 /* Derived server parameters: */
 #define VICTORY_TIME        (VICTORY_SECONDS*SERVER_FPS)
 #define WARMUP_TIME         (WARMUP_SECONDS*SERVER_FPS)
-#define MAX_PLAYERS         (PLAYERS_PER_CLIENT*MAX_CLIENTS)
+#define MAX_PLAYERS         (256)  /* player indices are sent as bytes */
 
 /* Configurable server parameters: */
 static int SERVER_PORT       = 12321;  /*  1 */
@@ -87,8 +92,12 @@ static int WARMUP_SECONDS    =     3;  /* 11 */
 static int VICTORY_SECONDS   =     3;  /* 12 */
 static char REPLAY_DIR[MAX_PATH];      /* 13 */
 static char BITMAP_DIR[MAX_PATH];      /* 14 */
+static int SIMULATE          =     0;  /* 15 */
+static int SIM_BOTS          =     4;  /* 16 */
+static int RANDOM_SEED       =     0;  /* 17 */
+static char SIM_BOT_NAMES[MAX_PATH] = "Spacey";  /* 18 */
 
-#define NUM_OPTIONS 14
+#define NUM_OPTIONS 18
 
 #define INT_OPT(n, d, v, mn, mx) { .name=n, .description=d, .type=OptInt, \
     .var={ .int_var={ .var=&v, .min=mn, .max=mx } } }
@@ -116,7 +125,15 @@ static struct Option options[NUM_OPTIONS] = {
     INT_OPT("victory_secs", "extra time at end of game (seconds)",
                                                    VICTORY_SECONDS,  1,     5),
     STR_OPT("replay_dir", "directory to write replays to", REPLAY_DIR),
-    STR_OPT("bitmap_dir", "directory to write field bitmaps to", BITMAP_DIR) };
+    STR_OPT("bitmap_dir", "directory to write field bitmaps to", BITMAP_DIR),
+    INT_OPT("simulate", "number of rounds to simulate headless (0: disabled)",
+                                                   SIMULATE,         0, 1000000),
+    INT_OPT("sim_bots", "number of bots playing in simulation mode",
+                                                   SIM_BOTS,   1, MAX_PLAYERS),
+    INT_OPT("seed", "random seed (0: seed with current time)",
+                                                   RANDOM_SEED, 0, 2147483647),
+    STR_OPT("sim_bot_names", "bots playing in simulation mode (comma-separated)",
+                                                   SIM_BOT_NAMES) };
 
 #undef INT_OPT
 #undef STR_OPT
@@ -126,45 +143,59 @@ typedef struct Player
     /* Set to false if the player is in use. If true, name must be valid. */
     bool            in_use;
 
-    /* Move buffer */
-    int             timestamp;
-    char            moves_queue[MOVE_BACKLOG];
-    int             moves_queue_len;
-    bool            has_moved;              /* did player move during warmup? */
-
     /* Player info */
-    int             index;
-    int             dead_since;
+    int             index;          /* index in game (or -1 if not playing) */
     int             flags;
     char            name[MAX_NAME_LEN + 1];
     struct RGB      color;
-    Position        pos;
 
     /* Scores */
     int             score_total;
     int             score_moving_sum;
-    int             score_history[MAX_SCORE_HISTORY];
+    int             *score_history;         /* SCORE_HISTORY entries */
     int             score_holes;
 
-    /* Hole creation */
-    int             hole;           /* remaining length of hole (in frames) */
-    int             solid_since;    /* timestamp after last hole */
-    int             my_holeid;      /* id of current hole being created */
-    int             cross_holeid;   /* id of hole being crossed */
-
-    /* Multiply-with-carry RNG for this player
-       (used to determine random state transitions) */
-    unsigned        rng_base;       /* base (current) value */
-    unsigned        rng_carry;      /* last carry value */
-
     /* Fast-forward state */
-    unsigned char   ff_buf[MAX_FF_LEN];    /* movement data buffer */
+    unsigned char   *ff_buf;               /* movement data buffer */
     int             ff_len;                /* movement data length */
+    int             ff_size;               /* allocated buffer size */
 } Player;
 
 
+/* Simulation state of the players in the current game, indexed by player
+   index. This is kept in parallel arrays instead of in Player (which is
+   embedded in the Client structures) so the frame loop runs over contiguous
+   memory rather than chasing pointers. */
+typedef struct PlayerStates
+{
+    int             timestamp[MAX_PLAYERS];     /* timestamp of next move */
+    int             dead_since[MAX_PLAYERS];    /* -1 while alive */
+    Position        pos[MAX_PLAYERS];
+    bool            has_moved[MAX_PLAYERS];     /* moved during warmup? */
+
+    /* Hole creation */
+    int             hole[MAX_PLAYERS];          /* remaining length of hole
+                                                   (in frames) at last move */
+    int             my_holeid[MAX_PLAYERS];     /* id of hole being created */
+    int             cross_holeid[MAX_PLAYERS];  /* id of hole being crossed */
+
+    /* Move buffers: queued moves are stored in slot (timestamp % size), and
+       slots not holding a move for their current timestamp are ignored. */
+    int             moves_next[MAX_PLAYERS];    /* timestamp of next
+                                                   untimestamped move */
+    char            moves_queue[MAX_PLAYERS][MOVE_QUEUE_SIZE];
+    int             moves_queue_time[MAX_PLAYERS][MOVE_QUEUE_SIZE];
+
+    /* Frames at which holes are made */
+    HoleSchedule    holes[MAX_PLAYERS];
+} PlayerStates;
+
+
+/* Clients are allocated when they connect, and freed after they disconnect
+   (but not before the game ends if they had players in it). */
 typedef struct Client
 {
+    int             id;             /* index in g_clients */
     bool            in_use;         /* is client connected? */
     bool            joined;         /* have we received a JOIN? */
     bool            started;        /* game start acknowledged? */
@@ -177,8 +208,7 @@ typedef struct Client
 
     /* Streaming data */
     SOCKET          fd_stream;
-    unsigned char   buf[MAX_PACKET_LEN + 2];
-    int             buf_pos;
+    PacketBuffer    stream;         /* received stream data */
 
     /* Players controlled by the client */
     Player          players[PLAYERS_PER_CLIENT];
@@ -198,8 +228,12 @@ static int g_num_players;       /* Number of people in the current game */
 static int g_num_alive;         /* Number of people still alive */
 static unsigned g_gameid;       /* Game identifier (also used as random seed) */
 static unsigned g_num_holes;    /* Number of holes created */
-static Client g_clients[MAX_CLIENTS];
+static int g_num_games;         /* Number of games started */
+static bool g_scores_changed;   /* Scores changed since last broadcast? */
+static Client **g_clients;      /* Client slots (NULL if unused) */
+static int g_clients_size;      /* Number of client slots allocated */
 static Player *g_players[MAX_PLAYERS];
+static PlayerStates g_ps;       /* Simulation state of g_players */
 static unsigned char g_field[FIELD_SIZE][FIELD_SIZE];
 static unsigned char g_holes[FIELD_SIZE][FIELD_SIZE];
 
@@ -229,6 +263,12 @@ static bool rgb_black(const struct RGB *c);
 /* Disconnect a client (sending the given reason, if possible) */
 static void client_disconnect(Client *cl, const char *reason);
 
+/* Allocates a new (zeroed) client, or returns NULL if out of memory */
+static Client *client_alloc(void);
+
+/* Frees clients that have disconnected and have no players in the game */
+static void clients_free_unused(void);
+
 /* Start a new packet with the given type */
 static void packet_begin(int type);
 
@@ -253,6 +293,9 @@ static void packet_broadcast(void);
 /* Kill a player */
 static void player_kill(Player *p);
 
+/* Returns whether the player takes part in the current game and is alive */
+static bool player_alive(const Player *pl);
+
 /* Send a formatted server message */
 static void message(const char *fmt, ...);
 
@@ -262,6 +305,15 @@ static void handle_FEAT(Client *cl, unsigned char *buf, size_t len);
 static void handle_JOIN(Client *cl, unsigned char *buf, size_t len);
 static void handle_CHAT(Client *cl, unsigned char *buf, size_t len);
 static void handle_MOVE(Client *cl, unsigned char *buf, size_t len);
+static void handle_MOVT(Client *cl, unsigned char *buf, size_t len);
+
+/* Move queue handling (by player index) */
+static void move_queue_clear(int i);
+static bool move_queue_put(int i, int timestamp, Move m);
+static bool move_queue_get(int i, Move *m);
+
+/* Finish the current game (write bitmap and replay, update scores) */
+static void finish_game(void);
 
 /* Restart the game (called when all players have died) */
 static void restart_game(void);
@@ -269,12 +321,18 @@ static void restart_game(void);
 /* Send scores to all clients */
 static void send_scores(Client *cl);
 
+/* Determine if the current game has ended. */
+static bool game_over(void);
+
 /* Process a server frame. */
 static void do_frame(void);
 
 /* Server main loop */
 static int run(void);
 
+/* Headless simulation main loop (used instead of run() if SIMULATE > 0) */
+static int run_simulation(void);
+
 /* Application entry point */
 int main(int argc, char *argv[]);
 
@@ -387,10 +445,10 @@ static void packet_end(void)
 
 static void packet_broadcast(void)
 {
-    for (int n = 0; n < MAX_CLIENTS; ++n)
+    for (int n = 0; n < g_clients_size; ++n)
     {
-        Client *cl = &g_clients[n];
-        if (!cl->in_use) continue;
+        Client *cl = g_clients[n];
+        if (cl == NULL || !cl->in_use) continue;
         packet_send(cl);
     }
 }
@@ -403,6 +461,9 @@ static void packet_send(Client *cl)
     /* Verify that packet_end() has been called: */
     assert(buf[0] || buf[1]);
 
+    /* Simulated clients have no connection to send to */
+    if (cl->fd_stream == INVALID_SOCKET) return;
+
     if (send(cl->fd_stream, buf, len, 0) != (ssize_t)len)
     {
         info("reliable send() failed");
@@ -426,7 +487,7 @@ static void client_disconnect(Client *cl, const char *reason)
     if (!cl->in_use) return;
 
     info( "disconnecting client %d at %s:%d (reason: %s)",
-          cl - g_clients, inet_ntoa(cl->sa_remote.sin_addr),
+          cl->id, inet_ntoa(cl->sa_remote.sin_addr),
           ntohs(cl->sa_remote.sin_port), reason );
 
     /* Remove client -- it's important to do this first, because functions like
@@ -455,6 +516,47 @@ static void client_disconnect(Client *cl, const char *reason)
     close(cl->fd_stream);
 }
 
+static Client *client_alloc(void)
+{
+    int n = 0;
+    while (n < g_clients_size && g_clients[n] != NULL) ++n;
+    if (n == g_clients_size)
+    {
+        /* Grow the client table */
+        int size = g_clients_size > 0 ? 2*g_clients_size : 16;
+        Client **clients = (Client**)realloc(g_clients, size*sizeof(Client*));
+        if (clients == NULL) return NULL;
+        memset(clients + g_clients_size, 0,
+               (size - g_clients_size)*sizeof(Client*));
+        g_clients      = clients;
+        g_clients_size = size;
+    }
+
+    Client *cl = (Client*)calloc(1, sizeof(Client));
+    if (cl == NULL) return NULL;
+    cl->id = n;
+    g_clients[n] = cl;
+    return cl;
+}
+
+static void clients_free_unused(void)
+{
+    for (int n = 0; n < g_clients_size; ++n)
+    {
+        Client *cl = g_clients[n];
+        if (cl == NULL || cl->in_use || cl->zombie) continue;
+
+        for (int m = 0; m < PLAYERS_PER_CLIENT; ++m)
+        {
+            free(cl->players[m].score_history);
+            free(cl->players[m].ff_buf);
+        }
+        packet_buffer_free(&cl->stream);
+        free(cl);
+        g_clients[n] = NULL;
+    }
+}
+
 static void message(const char *fmt, ...)
 {
     va_list ap;
@@ -479,33 +581,34 @@ static void player_kill(Player *pl)
         return;
     }
 
-    if (pl->dead_since != -1) return;
+    if (!player_alive(pl)) return;
 
-    info("player %d died.", pl->index);
+    int i = pl->index;
+    info("player %d died.", i);
+    if (SIMULATE > 0) sim_bots_kill(i);
 
     /* Set player dead */
-    pl->dead_since = pl->timestamp;
+    g_ps.dead_since[i] = g_ps.timestamp[i];
     --g_num_alive;
 
-    if (pl->timestamp >= WARMUP_TIME)
+    if (g_ps.timestamp[i] >= WARMUP_TIME)
     {
         if (g_num_alive <= 1 && g_deadline == -1)
         {
             /* End the game after a fixed number of seconds */
-            g_deadline = pl->timestamp + VICTORY_TIME;
+            g_deadline = g_ps.timestamp[i] + VICTORY_TIME;
         }
 
         /* Give remaining players a point.
            NB. if two players die in the same turn, they both get a point from
            each other's death.
            FIXME: current code isn't 100% correct when a player has lag...
-           FIXME: should g_timestamp really be pl->timestamp?
+           FIXME: should g_timestamp really be the player's timestamp?
         */
         for (int n = 0; n < g_num_players; ++n)
         {
-            if ( g_players[n] != pl && ( g_players[n]->dead_since == -1 ||
-                 g_players[n]->dead_since >=
-                     g_timestamp - (g_players[n] > pl ? 1 : 0) ) )
+            if ( n != i && ( g_ps.dead_since[n] == -1 ||
+                             g_ps.dead_since[n] >= g_timestamp - (n > i) ) )
             {
                 g_players[n]->score_total += 1;
                 g_players[n]->score_moving_sum += 1;
@@ -513,15 +616,20 @@ static void player_kill(Player *pl)
             }
         }
 
-        send_scores(NULL);
+        g_scores_changed = true;
     }
 }
 
+static bool player_alive(const Player *pl)
+{
+    return pl->index >= 0 && g_ps.dead_since[pl->index] == -1;
+}
+
 static void handle_packet(Client *cl, unsigned char *buf, size_t len)
 {
 /*
     info( "packet type %d of length %d received from client #%d",
-           (int)buf[0], len, cl - g_clients);
+           (int)buf[0], len, cl->id);
     hex_dump(buf, len);
 */
 
@@ -533,6 +641,7 @@ static void handle_packet(Client *cl, unsigned char *buf, size_t len)
     case MRCS_CHAT: return handle_CHAT(cl, buf, len);
     case MRCS_STRT: cl->started = true; return;
     case MRCS_MOVE: return handle_MOVE(cl, buf, len);
+    case MRCS_MOVT: return handle_MOVT(cl, buf, len);
     default: client_disconnect(cl, "invalid packet type");
     }
 }
@@ -591,6 +700,11 @@ static void handle_JOIN(Client *cl, unsigned char *buf, size_t len)
         client_disconnect(cl, "(JOIn) invalid number of players");
         return;
     }
+    if (P > 0 && (cl->feats & FEAT_SPECTATOR))
+    {
+        client_disconnect(cl, "(JOIN) spectators cannot join players");
+        return;
+    }
 
     size_t pos = 2;
     for (int p = 0; p < P; ++p)
@@ -639,16 +753,16 @@ static void handle_JOIN(Client *cl, unsigned char *buf, size_t len)
         pl->name[L] = '\0';
 
         /* Check availability of name */
-        for (int n = 0; n < MAX_CLIENTS; ++n)
+        for (int n = 0; n < g_clients_size; ++n)
         {
-            if (!g_clients[n].in_use) continue;
+            if (g_clients[n] == NULL || !g_clients[n]->in_use) continue;
             for (int m = 0; m < PLAYERS_PER_CLIENT; ++m)
             {
-                if (!g_clients[n].players[m].in_use) continue;
+                if (!g_clients[n]->players[m].in_use) continue;
 
-                if (&g_clients[n] == cl && m == p) continue;  /* skip self */
+                if (g_clients[n] == cl && m == p) continue;  /* skip self */
 
-                if (strcmp(cl->players[p].name, g_clients[n].players[m].name) == 0)
+                if (strcmp(cl->players[p].name, g_clients[n]->players[m].name) == 0)
                 {
                     char reason[128];
                     sprintf(reason, "(JOIN) player name \"%s\" already in use "
@@ -660,6 +774,8 @@ static void handle_JOIN(Client *cl, unsigned char *buf, size_t len)
         }
 
         /* Enable player */
+        pl->score_history = (int*)calloc(SCORE_HISTORY, sizeof(int));
+        if (pl->score_history == NULL) fatal("out of memory");
         pl->in_use = true;
         pl->index = -1;
     }
@@ -683,7 +799,7 @@ static void handle_JOIN(Client *cl, unsigned char *buf, size_t len)
         {
             const Player *pl = g_players[n];
             packet_write((char*)pl->ff_buf, pl->ff_len);
-            if (pl->dead_since >= 0) packet_write_byte((MOVE_DEAD<<6) + 1);
+            if (g_ps.dead_since[n] >= 0) packet_write_byte((MOVE_DEAD<<6) + 1);
             packet_write_byte(0);
         }
         packet_end();
@@ -707,11 +823,13 @@ static void handle_CHAT(Client *cl, unsigned char *buf, size_t len)
     name[L] = '\0';
     pos += L;
 
-    /* Get message text */
-    unsigned char *msg = &buf[pos];
+    /* Get message text (copied, since packet data must not be modified) */
+    char msg[256];
     size_t msg_len = len - pos;
     if (msg_len < 1) return;
     if (msg_len > 255) msg_len = 255;   /* limit chat message length */
+    memcpy(msg, &buf[pos], msg_len);
+    msg[msg_len] = '\0';
 
     /* Ensure player name is valid */
     Player *pl = NULL;
@@ -731,7 +849,6 @@ static void handle_CHAT(Client *cl, unsigned char *buf, size_t len)
         return;
     }
 
-    msg[msg_len] = '\0'; /* hack */
     info("(CHAT) %s: %s", pl->name, msg);
 
     /* Write to replay file */
@@ -771,7 +888,7 @@ static void handle_MOVE(Client *cl, unsigned char *buf, size_t len)
     if (len != 1 + P)
     {
         error( "(MOVE) invalid length packet received from client %d "
-               "(received %d; expected %d)", cl - g_clients, len, 1 + P );
+               "(received %d; expected %d)", cl->id, len, 1 + P );
         return;
     }
 
@@ -785,22 +902,120 @@ static void handle_MOVE(Client *cl, unsigned char *buf, size_t len)
             player_kill(pl);
         }
 
-        if (pl->dead_since == -1)
+        if (player_alive(pl))
         {
-            if (pl->moves_queue_len == MOVE_BACKLOG)
+            if (!move_queue_put(pl->index, g_ps.moves_next[pl->index], (Move)m))
             {
                 error("(MOVE) player move queue is full");
                 player_kill(pl);
             }
             else
             {
-                pl->moves_queue[pl->moves_queue_len++] = m;
+                ++g_ps.moves_next[pl->index];
             }
         }
     }
 }
 
-static void restart_game(void)
+static void handle_MOVT(Client *cl, unsigned char *buf, size_t len)
+{
+    if (!cl->started) return;
+
+    size_t P = 0;
+
+    while (P < PLAYERS_PER_CLIENT && cl->players[P].in_use) ++P;
+
+    if (len < 6)
+    {
+        error("(MOVT) truncated packet received from client %d", cl->id);
+        return;
+    }
+
+    unsigned timestamp = ((unsigned)buf[1] << 24) | ((unsigned)buf[2] << 16) |
+                         ((unsigned)buf[3] <<  8) | ((unsigned)buf[4] <<  0);
+    size_t N = buf[5];
+    if (len != 6 + P*N)
+    {
+        error( "(MOVT) invalid packet received from client %d "
+               "(length %d; expected %d)", cl->id, (int)len, (int)(6 + P*N) );
+        return;
+    }
+
+    for (size_t p = 0; p < P; ++p)
+    {
+        Player *pl = &cl->players[p];
+        if (!player_alive(pl)) continue;
+
+        /* Moves that do not fit in the move queue are dropped. Over an
+           unreliable connection they may be sent again later, but over the
+           stream connection they are lost, and the player will eventually
+           be killed for being out of sync. Checking this first also keeps
+           the timestamps below from overflowing. */
+        int i = pl->index;
+        if (timestamp >= (unsigned)g_ps.timestamp[i] + MOVE_QUEUE_SIZE)
+        {
+            warn( "(MOVT) moves from client %d too far ahead "
+                  "(timestamp %u; expected %d)",
+                  cl->id, timestamp, g_ps.timestamp[i] );
+            continue;
+        }
+
+        int next = (int)timestamp;
+        for (size_t n = 0; n < N && player_alive(pl); ++n)
+        {
+            int m = buf[6 + p*N + n];
+            if (m < MOVE_FORWARD || m > MOVE_DEAD)
+            {
+                error("(MOVT) received invalid move %d", m);
+                player_kill(pl);
+                break;
+            }
+            if (!move_queue_put(i, next, (Move)m))
+            {
+                warn( "(MOVT) moves from client %d too far ahead "
+                      "(timestamp %d; expected %d)",
+                      cl->id, next, g_ps.timestamp[i] );
+                break;
+            }
+            ++next;
+        }
+
+        /* Untimestamped moves continue after the last move stored */
+        if (g_ps.moves_next[i] < next) g_ps.moves_next[i] = next;
+    }
+}
+
+static void move_queue_clear(int i)
+{
+    for (int j = 0; j < MOVE_QUEUE_SIZE; ++j) g_ps.moves_queue_time[i][j] = -1;
+    g_ps.moves_next[i] = g_ps.timestamp[i];
+}
+
+/* Queues the move for the given timestamp, unless it has already been
+   received or processed (the first move received for a timestamp is kept).
+   Returns false if the timestamp is too far ahead. */
+static bool move_queue_put(int i, int timestamp, Move m)
+{
+    int slot = timestamp&(MOVE_QUEUE_SIZE - 1);
+    if (timestamp < g_ps.timestamp[i]) return true;
+    if (timestamp - g_ps.timestamp[i] >= MOVE_QUEUE_SIZE) return false;
+    if (g_ps.moves_queue_time[i][slot] == timestamp) return true;
+    g_ps.moves_queue[i][slot]      = (char)m;
+    g_ps.moves_queue_time[i][slot] = timestamp;
+    return true;
+}
+
+/* Retrieves the move for the player's current timestamp, if it has been
+   received. */
+static bool move_queue_get(int i, Move *m)
+{
+    int slot = g_ps.timestamp[i]&(MOVE_QUEUE_SIZE - 1);
+    if (g_ps.moves_queue_time[i][slot] != g_ps.timestamp[i]) return false;
+    *m = (Move)g_ps.moves_queue[i][slot];
+    return true;
+}
+
+static void finish_game(void)
 {
     /* Write a bitmap, but only if somebody moved in this game: */
     if (g_deadline > 0 && BITMAP_DIR[0] != '\0')
@@ -851,30 +1066,42 @@ static void restart_game(void)
             pl->score_holes = 0;
         }
     }
+}
+
+static void restart_game(void)
+{
+    finish_game();
 
     g_time_start = time_now();
     g_timestamp = 0;
     g_deadline = -1;
 
-    for (int n = 0; n < MAX_CLIENTS; ++n) g_clients[n].zombie = false;
+    for (int n = 0; n < g_clients_size; ++n)
+    {
+        if (g_clients[n] != NULL) g_clients[n]->zombie = false;
+    }
 
     /* Early out: if nobody is connected, don't bother with the rest. */
     if (g_num_clients == 0) return;
 
     /* Find players for the next game */
     g_num_players = 0;
-    for (int n = 0; n < MAX_CLIENTS; ++n)
+    for (int n = 0; n < g_clients_size; ++n)
     {
-        if (!g_clients[n].in_use) continue;
+        if (g_clients[n] == NULL || !g_clients[n]->in_use) continue;
 
         for (int m = 0; m < PLAYERS_PER_CLIENT; ++m)
         {
-            Player *pl = &g_clients[n].players[m];
-            if (pl->in_use)
+            Player *pl = &g_clients[n]->players[m];
+            if (!pl->in_use) continue;
+            if (g_num_players == MAX_PLAYERS)
             {
-                g_players[g_num_players] = pl;
-                pl->index = g_num_players++;
+                warn("too many players; %s has to wait", pl->name);
+                pl->index = -1;
+                continue;
             }
+            g_players[g_num_players] = pl;
+            pl->index = g_num_players++;
         }
     }
 
@@ -888,39 +1115,38 @@ static void restart_game(void)
                ((rand()&255) <<  0);
 
     info("starting game %08x with %d players", g_gameid, g_num_alive);
+    ++g_num_games;
 
     memset(g_field, 0, sizeof(g_field));
     memset(g_holes, 0, sizeof(g_holes));
     g_num_holes = 0;
 
     /* Initialize players */
+    HoleParams params = { WARMUP_TIME, HOLE_PROBABILITY, HOLE_LENGTH_MIN,
+                          HOLE_LENGTH_MAX, HOLE_COOLDOWN };
     for (int n = 0; n < g_num_players; ++n)
     {
-        Player *pl = g_players[n];
-
         /* Reset player state to starting position */
-        pl->timestamp       = 0;
-        pl->moves_queue_len = 0;
-        pl->has_moved       = false;
-        pl->dead_since      = -1;
-        pl->pos.x           = rand_int(2048, 65536 - 2048);
-        pl->pos.y           = rand_int(2048, 65536 - 2048);
-        pl->pos.a           = rand_int(0, 65535);
-        pl->hole            = 0;
-        pl->solid_since     = 0;
-        pl->my_holeid       = 0;
-        pl->cross_holeid    = 0;
-        pl->rng_base        = g_gameid ^ n;
-        pl->rng_carry       = 0;
-        pl->ff_len          = 0;
+        g_ps.timestamp[n]       = 0;
+        move_queue_clear(n);
+        g_ps.has_moved[n]       = false;
+        g_ps.dead_since[n]      = -1;
+        g_ps.pos[n].x           = rand_int(2048, 65536 - 2048);
+        g_ps.pos[n].y           = rand_int(2048, 65536 - 2048);
+        g_ps.pos[n].a           = rand_int(0, 65535);
+        g_ps.hole[n]            = 0;
+        g_ps.my_holeid[n]       = 0;
+        g_ps.cross_holeid[n]    = 0;
+        g_players[n]->ff_len    = 0;
+        hole_schedule_init(&g_ps.holes[n], &params, g_gameid, n);
     }
 
     /* Intialize clients */
-    for (int n = 0; n < MAX_CLIENTS; ++n)
+    for (int n = 0; n < g_clients_size; ++n)
     {
-        if (g_clients[n].in_use)
+        if (g_clients[n] != NULL && g_clients[n]->in_use)
         {
-            g_clients[n].started = false;
+            g_clients[n]->started = false;
         }
     }
 
@@ -987,9 +1213,9 @@ static void restart_game(void)
                 for (int n = 0; n < g_num_players; ++n)
                 {
                     fprintf( fp_replay, "%d %d %d %d %d %d\n",
-                             (int)g_players[n]->pos.x,
-                             (int)g_players[n]->pos.y,
-                             (int)g_players[n]->pos.a,
+                             (int)g_ps.pos[n].x,
+                             (int)g_ps.pos[n].y,
+                             (int)g_ps.pos[n].a,
                              (int)g_players[n]->color.r,
                              (int)g_players[n]->color.g,
                              (int)g_players[n]->color.b );
@@ -1024,9 +1250,9 @@ static void restart_game(void)
         packet_write_byte(pl->color.r);
         packet_write_byte(pl->color.g);
         packet_write_byte(pl->color.b);
-        int x = (int)pl->pos.x;
-        int y = (int)pl->pos.y;
-        int a = (int)pl->pos.a;
+        int x = (int)g_ps.pos[i].x;
+        int y = (int)g_ps.pos[i].y;
+        int a = (int)g_ps.pos[i].a;
         packet_write_byte((x>>8)&255);
         packet_write_byte((x>>0)&255);
         packet_write_byte((y>>8)&255);
@@ -1046,10 +1272,18 @@ static void restart_game(void)
     /* Convert positions to more practical format */
     for (int i = 0; i < g_num_players; ++i)
     {
-        Player *pl = g_players[i];
-        pl->pos.x *= 1.0/65536;
-        pl->pos.y *= 1.0/65536;
-        pl->pos.a *= 2*M_PI/65536;
+        g_ps.pos[i].x *= 1.0/65536;
+        g_ps.pos[i].y *= 1.0/65536;
+        g_ps.pos[i].a *= 2*M_PI/65536;
+    }
+
+    if (SIMULATE > 0)
+    {
+        SimGame game = { g_gameid, SERVER_FPS, TURN_RATE, MOVE_RATE,
+                         LINE_WIDTH, WARMUP_TIME, SCORE_HISTORY,
+                         HOLE_PROBABILITY, HOLE_LENGTH_MIN, HOLE_LENGTH_MAX,
+                         HOLE_COOLDOWN, g_num_players };
+        sim_bots_restart(&game, g_ps.pos);
     }
 
     /* Send start packet to all clients */
@@ -1079,29 +1313,34 @@ static void send_scores(Client *cl)
     }
     packet_end();
     if (cl == NULL)
+    {
         packet_broadcast();
+        g_scores_changed = false;
+    }
     else
+    {
         packet_send(cl);
+    }
 }
 
-/* Executes one move for the given player and updates his timestamp: */
-static void do_player_move(Player *pl, Move m)
+/* Executes one move for the player with index i and updates his timestamp: */
+static void do_player_move(int i, Move m)
 {
-    assert(pl->dead_since == -1);
+    Player *pl = g_players[i];
+
+    assert(g_ps.dead_since[i] == -1);
 
-    if ( pl->hole == 0 &&
-            pl->timestamp >= WARMUP_TIME + HOLE_COOLDOWN &&
-            pl->timestamp - pl->solid_since >= HOLE_COOLDOWN &&
-            pl->rng_base%HOLE_PROBABILITY == 0 )
+    /* Look up hole state; a new hole starts if the remaining length did not
+       just count down from the previous move. */
+    int hole = hole_schedule_hole(&g_ps.holes[i], g_ps.timestamp[i]);
+    if (hole > 0 && g_ps.hole[i] != hole + 1)
     {
-        pl->hole = HOLE_LENGTH_MIN +
-                    (pl->rng_base/HOLE_PROBABILITY)
-                    % (HOLE_LENGTH_MAX - HOLE_LENGTH_MIN + 1);
-        pl->my_holeid = 1 + (g_num_holes++)%255;
+        g_ps.my_holeid[i] = 1 + (g_num_holes++)%255;
     }
+    g_ps.hole[i] = hole;
 
     /* Calculate movement */
-    int v = (pl->timestamp < WARMUP_TIME ? 0 : 1);
+    int v = (g_ps.timestamp[i] < WARMUP_TIME ? 0 : 1);
     int a = (m == MOVE_TURN_LEFT)  ? +1 :
             (m == MOVE_TURN_RIGHT) ? -1 : 0;
 
@@ -1109,59 +1348,60 @@ static void do_player_move(Player *pl, Move m)
     {
         /* Write to replay: player, turn, move*/
         fprintf( fp_replay, "MOVE %d %d %d\n",
-                    pl->index, a, (pl->hole ? 2 : v) );
+                    i, a, (g_ps.hole[i] ? 2 : v) );
     }
 
     /* Register movement during warmup */
-    if (!v && a) pl->has_moved = true;
+    if (!v && a) g_ps.has_moved[i] = true;
 
     /* Calculate new position */
-    Position npos = pl->pos;
+    Position npos = g_ps.pos[i];
     position_update(&npos, (Move)m, v*1e-3*MOVE_RATE, 2.0*M_PI/TURN_RATE);
 
+    Rect rect = { 0, 0, 0, 0 };
     if (v > 0)
     {
-        int color = pl->hole > 0 ? -1 : pl->index + 1;
+        int color = g_ps.hole[i] > 0 ? -1 : i + 1;
 
         /* Fill and test new line segment */
-        if ( field_line_th( &g_field, &pl->pos, &npos,
-                            FIELD_SIZE*1e-3*LINE_WIDTH, color, NULL ) != 0 )
+        if ( field_line_th( &g_field, &g_ps.pos[i], &npos,
+                            FIELD_SIZE*1e-3*LINE_WIDTH, color, &rect ) != 0 )
         {
             /* Player bumped into something! */
             player_kill(pl);
         }
 
         /* Detect hole crossing */
-        int holeid = field_line_th( &g_holes, &pl->pos, &npos,
-            4.0, (pl->hole > 0 ? pl->my_holeid : -1), NULL );
-        if (holeid < 256 && holeid != pl->cross_holeid)
+        int holeid = field_line_th( &g_holes, &g_ps.pos[i], &npos,
+            4.0, (g_ps.hole[i] > 0 ? g_ps.my_holeid[i] : -1), NULL );
+        if (holeid < 256 && holeid != g_ps.cross_holeid[i])
         {
-            if (pl->cross_holeid != 0)
+            if (g_ps.cross_holeid[i] != 0)
             {
                 pl->score_holes += 1;
-                send_scores(NULL);
+                g_scores_changed = true;
             }
-            pl->cross_holeid = holeid;
+            g_ps.cross_holeid[i] = holeid;
         }
     }
 
-    pl->pos = npos;
-
-    if (pl->hole > 0)
+    if (SIMULATE > 0)
     {
-        --pl->hole;
-        pl->solid_since = pl->timestamp + 1;
+        /* Let simulated players see the move */
+        sim_bots_watch( i, g_ps.timestamp[i], m, v*1e-3*MOVE_RATE,
+                        g_ps.hole[i], &g_ps.pos[i], &npos, &rect );
     }
 
+    g_ps.pos[i] = npos;
+
     /* Kill players that do not move during the warmup period */
-    if (pl->timestamp + 1 == WARMUP_TIME && !pl->has_moved) player_kill(pl);
+    if (g_ps.timestamp[i] + 1 == WARMUP_TIME && !g_ps.has_moved[i])
+    {
+        player_kill(pl);
+    }
 
-    /* Update player timestamp and RNG: */
-    ++pl->timestamp;
-    unsigned long long rng_next = pl->rng_base*1967773755ull
-                                + pl->rng_carry;
-    pl->rng_base  = rng_next&0xffffffff;
-    pl->rng_carry = rng_next>>32;
+    /* Update player timestamp: */
+    ++g_ps.timestamp[i];
 
     /* Add to fast-forward data buffer: */
     if ( pl->ff_len > 0 &&
@@ -1173,78 +1413,75 @@ static void do_player_move(Player *pl, Move m)
     else
     if (pl->ff_len < MAX_FF_LEN)
     {
+        if (pl->ff_len == pl->ff_size)
+        {
+            int size = pl->ff_size > 0 ? 2*pl->ff_size : 256;
+            if (size > MAX_FF_LEN) size = MAX_FF_LEN;
+            pl->ff_buf = (unsigned char*)realloc(pl->ff_buf, size);
+            if (pl->ff_buf == NULL) fatal("out of memory");
+            pl->ff_size = size;
+        }
         pl->ff_buf[pl->ff_len++] = (m << 6) + 1;  /* start new command */
     }
 }
 
+static bool game_over(void)
+{
+    return (g_num_alive == 0 && g_deadline == -1) ||
+           (g_deadline != -1 && g_timestamp >= g_deadline);
+}
+
 static void do_frame(void)
 {
-    char data[MAX_PLAYERS*(MOVE_BACKLOG + 1)], *ptr = data;
+    char data[2*MAX_PLAYERS*(MOVE_QUEUE_SIZE + 1)], *ptr = data;
 
     if (g_num_clients == 0) return;
 
-    if ( (g_num_alive == 0 && g_deadline == -1) ||
-         (g_deadline != -1 && g_timestamp >= g_deadline) )
-    {
-        restart_game();
-    }
+    if (game_over()) restart_game();
 
     if (g_num_players == 0) return;
 
     /* Process player moves */
     for (int n = 0; n < g_num_players; ++n)
     {
-        Player *pl = g_players[n];
-
-        bool just_died = pl->dead_since == pl->timestamp;
+        bool just_died = g_ps.dead_since[n] == g_ps.timestamp[n];
 
-        if (pl->dead_since == -1)  /* player alive? */
+        if (g_ps.dead_since[n] == -1)  /* player alive? */
         {
             int pos;
-            for ( pos = 0; pl->timestamp < g_timestamp &&
-                           pos < pl->moves_queue_len; ++pos )
+            Move m;
+            for ( pos = 0; g_ps.timestamp[n] < g_timestamp &&
+                           move_queue_get(n, &m); ++pos )
             {
-                Move m = pl->moves_queue[pos];
-                *ptr++ = (char)pl->index;
+                *ptr++ = (char)n;
                 *ptr++ = (char)m;
-                do_player_move(pl, m);
-                if (pl->dead_since >= 0)
+                do_player_move(n, m);
+                if (g_ps.dead_since[n] >= 0)
                 {
                     just_died = true;
                     break;
                 }
             }
 
-            if (pos > 0)
-            {
-                /* Move remaining moves to the front of the queue: */
-                pl->moves_queue_len -= pos;
-                if (pl->moves_queue_len > 0)
-                {
-                    memmove( pl->moves_queue, pl->moves_queue + pos,
-                            sizeof(*pl->moves_queue)*pl->moves_queue_len );
-                }
-            }
-            else
-            if (g_timestamp - g_players[n]->timestamp > MOVE_BACKLOG)
+            if (pos == 0 && g_timestamp - g_ps.timestamp[n] > MOVE_BACKLOG)
             {
                 /* Check if player is out of sync: */
                 message("Killed %s: client out-of-sync!", g_players[n]->name);
-                player_kill(pl);
+                player_kill(g_players[n]);
                 just_died = true;
             }
         }
 
         if (just_died)
         {
-            *ptr++ = (char)pl->index;
+            *ptr++ = (char)n;
             *ptr++ = (char)MOVE_DEAD;
         }
 
-        if (pl->dead_since >= 0)
+        if (g_ps.dead_since[n] >= 0)
         {
-            pl->timestamp = g_timestamp;  /* implicitely up-to-date */
-            pl->moves_queue_len = 0;      /* discard queued moves */
+            g_ps.timestamp[n] = g_timestamp;  /* implicitely up-to-date */
+            move_queue_clear(n);              /* discard queued moves */
         }
     }
 
@@ -1253,6 +1490,10 @@ static void do_frame(void)
     packet_write(data, ptr - data);
     packet_end();
     packet_broadcast();
+
+    /* Broadcast scores once for all deaths and hole crossings (including
+       those that occurred between frames) */
+    if (g_scores_changed) send_scores(NULL);
 }
 
 /* Processes frames until the server is up to date, and returns the
@@ -1274,6 +1515,8 @@ static int run(void)
 {
     for (;;)
     {
+        clients_free_unused();
+
         /* Calculcate select time-out */
         struct timeval timeout;
         double delay = process_frames();
@@ -1286,13 +1529,13 @@ static int run(void)
         FD_SET(g_fd_listen, &readfds);
         FD_SET(g_fd_packet, &readfds);
         int max_fd = g_fd_listen > g_fd_packet ? g_fd_listen : g_fd_packet;
-        for (int n = 0; n < MAX_CLIENTS; ++n)
+        for (int n = 0; n < g_clients_size; ++n)
         {
-            if (!g_clients[n].in_use) continue;
-            FD_SET(g_clients[n].fd_stream, &readfds);
-            if ((int)g_clients[n].fd_stream > max_fd)
+            if (g_clients[n] == NULL || !g_clients[n]->in_use) continue;
+            FD_SET(g_clients[n]->fd_stream, &readfds);
+            if ((int)g_clients[n]->fd_stream > max_fd)
             {
-                max_fd = g_clients[n].fd_stream;
+                max_fd = g_clients[n]->fd_stream;
             }
         }
 
@@ -1329,10 +1572,18 @@ static int run(void)
             }
             else
             {
-                int n = 0;
-                while ( n < MAX_CLIENTS &&
-                        (g_clients[n].in_use || g_clients[n].zombie) ) ++n;
-                if (n == MAX_CLIENTS)
+                Client *cl = NULL;
+#ifndef WIN32
+                /* select() cannot wait on higher-numbered descriptors */
+                if (fd < FD_SETSIZE)
+#endif
+                cl = client_alloc();
+                if ( cl != NULL &&
+                     !packet_buffer_init(&cl->stream, STREAM_BUFFER_SIZE) )
+                {
+                    cl = NULL;  /* unused slot is freed later */
+                }
+                if (cl == NULL)
                 {
                     warn( "no client slot free; rejecting connection from %s:%d",
                           inet_ntoa(sa.sin_addr), ntohs(sa.sin_port) );
@@ -1341,13 +1592,11 @@ static int run(void)
                 else
                 {
                     info( "accepted client from %s:%d in slot #%d",
-                          inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), n );
+                          inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), cl->id );
 
-                    /* Initialize new client slot */
-                    memset(&g_clients[n], 0, sizeof(g_clients[n]));
-                    g_clients[n].sa_remote = sa;
-                    g_clients[n].fd_stream = fd;
-                    g_clients[n].in_use    = true;
+                    cl->sa_remote = sa;
+                    cl->fd_stream = fd;
+                    cl->in_use    = true;
                     g_num_clients += 1;
                 }
             }
@@ -1384,14 +1633,14 @@ static int run(void)
             else
             {
                 Client *cl = NULL;
-                for (int n = 0; n < MAX_CLIENTS; ++n)
+                for (int n = 0; n < g_clients_size; ++n)
                 {
-                    if ( g_clients[n].in_use &&
-                         g_clients[n].sa_remote.sin_addr.s_addr ==
+                    if ( g_clients[n] != NULL && g_clients[n]->in_use &&
+                         g_clients[n]->sa_remote.sin_addr.s_addr ==
                             sa.sin_addr.s_addr &&
-                         g_clients[n].sa_remote.sin_port == sa.sin_port )
+                         g_clients[n]->sa_remote.sin_port == sa.sin_port )
                     {
-                        cl = &g_clients[n];
+                        cl = g_clients[n];
                         break;
                     }
                 }
@@ -1408,39 +1657,36 @@ static int run(void)
         }
 
         /* Accept incoming stream packets */
-        for (int n = 0; n < MAX_CLIENTS; ++n)
+        for (int n = 0; n < g_clients_size; ++n)
         {
-            Client *cl = &g_clients[n];
+            Client *cl = g_clients[n];
 
-            if (!cl->in_use) continue;
+            if (cl == NULL || !cl->in_use) continue;
 
             if (!FD_ISSET(cl->fd_stream, &readfds)) continue;
 
-            ssize_t read = recv( cl->fd_stream, cl->buf + cl->buf_pos,
-                                 sizeof(cl->buf) - cl->buf_pos, 0 );
+            size_t space;
+            unsigned char *buf = packet_buffer_space(&cl->stream, &space);
+            ssize_t read = recv(cl->fd_stream, buf, space, 0);
             if (read <= 0)
             {
                 client_disconnect(cl, read == 0 ? "EOF reached" : "recv() failed");
             }
             else
             {
-                cl->buf_pos += read;
-                while (cl->in_use && cl->buf_pos >= 2)
+                size_t len;
+                int res;
+                packet_buffer_commit(&cl->stream, read);
+                while ( cl->in_use &&
+                        (res = packet_buffer_next( &cl->stream, MAX_PACKET_LEN,
+                                                   &buf, &len )) != 0 )
                 {
-                    int len = 256*cl->buf[0] + cl->buf[1];
-                    if (len > MAX_PACKET_LEN)
+                    if (res < 0)
                     {
-                        client_disconnect(cl, "packet too large");
+                        client_disconnect(cl, "invalid packet length");
                         break;
                     }
-                    if (len < 1)
-                    {
-                        client_disconnect(cl, "packet too small");
-                        break;
-                    }
-                    if (cl->buf_pos < len + 2) break;
-                    handle_packet(cl, cl->buf + 2, len);
-                    memmove(cl->buf, cl->buf + len + 2, cl->buf_pos -= len + 2);
+                    handle_packet(cl, buf, len);
                 }
             }
         }
@@ -1448,6 +1694,83 @@ static int run(void)
     return 0;
 }
 
+static int run_simulation(void)
+{
+    long long frames = 0;
+
+    /* Create a simulated client with a single bot player for each bot.
+       Bots are loaded from bots/NAME.so relative to the working directory
+       (so run the server from the client directory) and take turns in the
+       order given; player n uses the n-th bot, as players are assigned
+       indices in order of the client table. */
+    const char *bot_name = SIM_BOT_NAMES;
+    for (int n = 0; n < SIM_BOTS; ++n)
+    {
+        size_t len = strcspn(bot_name, ",");
+        if (len == 0 || len > MAX_NAME_LEN - 4)
+        {
+            fatal("invalid bot name in \"%s\"", SIM_BOT_NAMES);
+        }
+
+        Client *cl = client_alloc();
+        if (cl == NULL) fatal("out of memory");
+        cl->in_use    = true;
+        cl->joined    = true;
+        cl->fd_stream = INVALID_SOCKET;
+        cl->players[0].score_history = (int*)calloc(SCORE_HISTORY, sizeof(int));
+        if (cl->players[0].score_history == NULL) fatal("out of memory");
+        cl->players[0].in_use = true;
+        cl->players[0].index  = -1;
+        cl->players[0].flags  = PLFL_BOT;
+        sprintf( cl->players[0].name, "%.*s-%d",
+                 (int)len, bot_name, n + 1 );
+        if (!sim_bot_load(n, cl->players[0].name))
+        {
+            fatal("could not load bot \"%.*s\"", (int)len, bot_name);
+        }
+        g_num_clients += 1;
+        bot_name += len;
+        bot_name = *bot_name == ',' ? bot_name + 1 : SIM_BOT_NAMES;
+    }
+
+    info("simulating %d rounds with %d bots", SIMULATE, SIM_BOTS);
+
+    /* Process frames as fast as possible, using the frame counter as clock */
+    double time_start = time_now();
+    for (;;)
+    {
+        ++g_timestamp;
+        if (g_num_games == SIMULATE && game_over()) break;
+
+        for (int n = 0; n < g_num_players; ++n)
+        {
+            Move m;
+            if (g_ps.dead_since[n] == -1 && !move_queue_get(n, &m))
+            {
+                m = sim_bot_move(n, g_ps.timestamp[n], &g_field);
+                move_queue_put(n, g_ps.timestamp[n], m);
+            }
+        }
+        for (int n = 0; n < g_num_clients; ++n) g_clients[n]->started = true;
+        do_frame();
+        ++frames;
+    }
+    finish_game();
+    double elapsed = time_now() - time_start;
+    sim_bots_free();
+
+    /* Report final scores and throughput */
+    printf("%-20s %6s %6s\n", "player", "total", "recent");
+    for (int n = 0; n < g_num_players; ++n)
+    {
+        printf( "%-20s %6d %6d\n", g_players[n]->name,
+                g_players[n]->score_total, g_players[n]->score_moving_sum );
+    }
+    printf( "%lld frames simulated in %.3f seconds (%.1f frames/second)\n",
+            frames, elapsed, elapsed > 0 ? frames/elapsed : 0.0 );
+    return 0;
+}
+
 static char *trim(char *str)
 {
     char *eol = str + strlen(str);
@@ -1591,7 +1914,6 @@ static void read_config_file(void)
 
 int main(int argc, char *argv[])
 {
-    srandom(time(NULL));
     time_reset();
 
     if (argc >= 2 && strcmp(argv[1], "--default-config") == 0)
@@ -1603,6 +1925,16 @@ int main(int argc, char *argv[])
     read_config_file();
     parse_args(argc, argv);
 
+    /* Seed random number generators (a fixed seed makes games reproducible).
+       random() picks starting positions (see rand_int()) and rand() picks
+       game ids, which determine the hole schedules; both get the same seed. */
+    unsigned seed = RANDOM_SEED != 0 ? (unsigned)RANDOM_SEED
+                                     : (unsigned)time(NULL);
+    srandom(seed);
+    srand(seed);
+
+    if (SIMULATE > 0) return run_simulation();
+
 #ifdef WIN32
     WSADATA wsaData;
     if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0)